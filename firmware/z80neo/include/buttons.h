@@ -0,0 +1,63 @@
+#ifndef BUTTONS_H
+#define BUTTONS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <pico/stdlib.h>
+
+// Front panel buttons.
+//
+// All buttons share one ADC input through a resistor ladder. The ADC runs
+// free on that input into its FIFO and a repeating timer on the UI core
+// averages what came in every BUTTON_SAMPLE_US. The level is turned into a
+// button by the caller's classifier, debounced over BUTTON_DEBOUNCE samples,
+// and the changes go into an event queue. Holding a button gives one
+// BUTTON_LONG event after BUTTON_LONG_US and BUTTON_REPEAT events every
+// BUTTON_REPEAT_US after that.
+//
+// Reading the state or the queue never touches the ADC, and
+// buttons_sleep() lets the UI core sleep until the next sample.
+
+typedef enum { NONE, UP, DOWN, BACK, OK, CANCEL, CANCEL2 } button_state;
+
+typedef enum {
+	BUTTON_PRESS,
+	BUTTON_RELEASE,
+	BUTTON_LONG,
+	BUTTON_REPEAT
+} button_event_type;
+
+typedef struct {
+	button_event_type type;
+	button_state button;
+	uint32_t held_us; // time since the press, 0 on BUTTON_PRESS
+} button_event;
+
+#define BUTTON_SAMPLE_US (5 * 1000)
+#define BUTTON_DEBOUNCE 3
+#define BUTTON_LONG_US (400 * 1000)
+#define BUTTON_REPEAT_US (80 * 1000)
+#define BUTTON_QUEUE_LEN 16
+
+typedef button_state (*button_classifier)(uint16_t adc);
+typedef void (*button_hook)(button_state button);
+
+// buttons_init() is enough for the boot code, which polls through
+// buttons_sleep(). buttons_start() hands the sampling to the timer and has to
+// be called from the core that consumes the events, the interrupt runs there.
+void buttons_init(uint adc_input, button_classifier classify);
+void buttons_start(void);
+
+button_state buttons_state(void);
+uint16_t buttons_adc(void);
+
+bool buttons_get(button_event *ev);
+void buttons_flush(void);
+
+void buttons_sleep(void);
+
+// Called from the timer interrupt on every press, on top of the queue
+void buttons_on_press(button_hook hook);
+
+#endif // BUTTONS_H
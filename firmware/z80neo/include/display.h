@@ -0,0 +1,33 @@
+#ifndef DISPLAY_H
+#define DISPLAY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Display layer on top of the SSD1306 driver.
+//
+// Drawing still goes into the framebuffer returned by display_init() with
+// WriteString() and friends.
+// Instead of pushing the whole frame after every print, callers mark it as
+// changed with display_request(). Flushes compare the framebuffer with a copy
+// of what the panel shows and only send the changed column span of each page,
+// at most once per DISPLAY_FRAME_US. Anything left pending goes out on the
+// next display_tick().
+//
+// Flushes only queue the transfer, the driver streams it to the panel with
+// DMA while the caller goes on drawing.
+
+#define DISPLAY_FPS 30
+#define DISPLAY_FRAME_US (1000000 / DISPLAY_FPS)
+
+uint8_t *display_init(void);
+void display_invalidate(void);
+
+void display_request(void);
+bool display_frame_due(void);
+bool display_tick(void);
+void display_flush(void);
+
+void display_sleep_ms(uint32_t ms);
+
+#endif // DISPLAY_H
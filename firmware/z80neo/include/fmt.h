@@ -0,0 +1,14 @@
+#ifndef FMT_H
+#define FMT_H
+
+#include <stdint.h>
+
+// Number formatting for the UI fields without going through printf.
+//
+// Each call writes at p, nul terminates and returns the terminator, so a line
+// is built by chaining calls into one buffer.
+
+char *fmt_hex(char *p, uint32_t v, int digits);
+char *fmt_str(char *p, const char *s);
+
+#endif // FMT_H
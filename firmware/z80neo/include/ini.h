@@ -0,0 +1,22 @@
+#ifndef INI_H
+#define INI_H
+
+#include <stddef.h>
+
+// Minimal single pass INI parser.
+//
+// Works in place on a buffer holding the whole file, with room for one more
+// byte after the last one (it gets terminated). Every "key = value" line
+// is handed to the handler with both sides trimmed. Empty lines, comments
+// (';' or '#') and [section] headers are skipped. Lines without '=' are passed
+// with key == NULL so callers can still read the old positional format.
+//
+// No Pico dependencies, it builds on the host as is.
+
+typedef void (*ini_handler)(const char *key, const char *value, int line, void *user);
+
+int ini_parse(char *text, size_t len, ini_handler handler, void *user);
+
+int ini_key_is(const char *key, const char *name);
+
+#endif // INI_H
@@ -0,0 +1,81 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Deferred log.
+//
+// LOG() writes a fixed size binary record (time, event id, two arguments)
+// into the ring of the calling core, lock free, so it is safe in the bus ISR
+// and costs a few dozen cycles. Nothing is formatted there: core0 takes the
+// records out with log_get() and either formats them (log_format()) or ships
+// them as they are, and core1 can keep them in a rotating file on the SD card.
+//
+// Events are declared in log_events.h with a level and a format. Events below
+// LOG_LEVEL are compiled out, arguments and all.
+//
+//   LOG(LOAD_BIN, load_bytes, bank);
+
+#define LOG_DEBUG 0
+#define LOG_INFO 1
+#define LOG_WARN 2
+#define LOG_ERROR 3
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_INFO
+#endif
+
+#define LOG_SLOTS 64 // per core, power of 2
+#define LOG_LINE_SIZE 96
+
+// on the wire and in the file as is, little endian, 16 bytes
+typedef struct {
+	uint32_t time_us;
+	uint16_t id;
+	uint8_t level;
+	uint8_t core;
+	uint32_t a;
+	uint32_t b;
+} log_record;
+
+enum {
+#define LOG_EVENT(name, level, fmt) LOG_ID_##name,
+#include "log_events.h"
+#undef LOG_EVENT
+	LOG_EVENTS
+};
+
+enum {
+#define LOG_EVENT(name, level, fmt) LOG_LEVEL_##name = level,
+#include "log_events.h"
+#undef LOG_EVENT
+};
+
+#define LOG(ev, ...) LOG_ARGS(ev, ##__VA_ARGS__, 0, 0)
+#define LOG_ARGS(ev, a, b, ...)                                                \
+	do {                                                                       \
+		if (LOG_LEVEL_##ev >= LOG_LEVEL)                                       \
+			log_put(LOG_ID_##ev, LOG_LEVEL_##ev, (uint32_t)(a), (uint32_t)(b)); \
+	} while (0)
+
+void log_init(void);
+void log_put(uint16_t id, uint8_t level, uint32_t a, uint32_t b);
+bool log_get(log_record *r);
+int log_format(const log_record *r, char *out, size_t len);
+
+// Rotating file on the SD card, raw records. core0 hands records over with
+// log_file_put(), core1 writes them from log_file_task() whenever it owns the
+// card.
+
+#define LOG_FILE "/Z80NEO.LOG"
+#define LOG_FILE_OLD "/Z80NEO.OLD"
+#define LOG_FILE_MAX (64 * 1024) // then it becomes LOG_FILE_OLD
+#define LOG_FILE_RECORDS 128 // waiting for core1, power of 2
+#define LOG_FILE_FLUSH_US (2 * 1000 * 1000) // write out a few records after this
+
+void log_file_put(const log_record *r);
+void log_file_task(void);
+
+#endif // LOG_H
@@ -0,0 +1,17 @@
+// Log events, see log.h. No include guard, it's included once per table.
+//
+// software/tools/logdecode.py reads this file to turn ids back into text:
+// one LOG_EVENT per line, and new events go at the end, the position is the
+// id in the records.
+//
+//        name          level      format, integer conversions on long values
+
+LOG_EVENT(DROPPED,      LOG_WARN,  "LOG %lu records lost, core %lu")
+LOG_EVENT(BOOT,         LOG_INFO,  "z80neo boot")
+LOG_EVENT(SERIAL_IN,    LOG_DEBUG, "SERIAL IN %02lx, %lu waiting")
+LOG_EVENT(HOST_TEXT,    LOG_WARN,  "RX1 %lu bytes, no command")
+LOG_EVENT(HOST_CMD,     LOG_INFO,  "HOST command %lu, bank %lu")
+LOG_EVENT(LOAD_BIN,     LOG_INFO,  "LOAD BIN %lu bytes, bank %lu")
+LOG_EVENT(LOAD_HEX,     LOG_INFO,  "LOAD HEX %lu bytes, bank %lu")
+LOG_EVENT(USB_DISK,     LOG_INFO,  "USB DISK %lu")
+LOG_EVENT(LOAD_PACKED,  LOG_INFO,  "LOAD PACKED %lu bytes unpacked, bank %lu")
@@ -0,0 +1,93 @@
+#ifndef PROTO_H
+#define PROTO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Binary host protocol on CDC 1.
+//
+// Frame:  SOF  cmd  seq  len (2, LE)  payload (len)  crc (2, LE)
+//
+// The CRC is CRC-16/CCITT-FALSE over cmd, seq, len and payload. Replies
+// carry the command with PROTO_REPLY set, the same seq, and a payload that
+// starts with a status byte. SOF is not printable, so frames and the text
+// commands (BENCH, RESET, ...) share the interface. A text command ends at
+// '\r' or '\n', or right before the SOF of a frame sent behind it.
+//
+// Requests (payload, multi byte values little endian):
+//
+//   PING                          -> version, banks, bank size (2), max data (2),
+//                                    flags (PROTO_CAN_RESET)
+//   WRITE  bank, addr (2), data   -> -
+//   READ   bank, addr (2), n (2)  -> data
+//   BANK   bank                   -> -    select the bank the Z80 runs from
+//   RESET                         -> -
+//   RUN    bank                   -> -    select and restart
+//
+// With log=raw in the INI the board also sends PROTO_LOG frames of its own,
+// status and then log_record's (log.h), seq counting on its own.
+//
+// No Pico dependencies, it builds on the host as is.
+
+#define PROTO_SOF 0xA5
+#define PROTO_VERSION 1
+#define PROTO_MAX_DATA 1024 // WRITE and READ, per frame
+#define PROTO_MAX_PAYLOAD (PROTO_MAX_DATA + 3) // WRITE bank and address
+#define PROTO_OVERHEAD 7 // SOF, cmd, seq, len, crc
+#define PROTO_LINE_MAX 64 // text command, without its line end
+
+#define PROTO_PING 0x01
+#define PROTO_WRITE 0x02
+#define PROTO_READ 0x03
+#define PROTO_BANK 0x04
+#define PROTO_RESET 0x05
+#define PROTO_RUN 0x06
+#define PROTO_LOG 0x40 // board to host only
+
+#define PROTO_REPLY 0x80
+
+#define PROTO_OK 0
+#define PROTO_ERR_CRC 1
+#define PROTO_ERR_LEN 2
+#define PROTO_ERR_CMD 3
+#define PROTO_ERR_ARG 4
+#define PROTO_ERR_BUSY 5
+
+// PING flags
+#define PROTO_CAN_RESET (1 << 0) // /RESET wired, else RESET and RUN only pause
+
+typedef struct {
+	uint8_t cmd;
+	uint8_t seq;
+	uint16_t len;
+	uint8_t payload[PROTO_MAX_PAYLOAD];
+} proto_frame;
+
+typedef struct {
+	int state;
+	uint16_t got;
+	uint16_t crc;
+	proto_frame frame;
+} proto_parser;
+
+typedef struct {
+	uint16_t len;
+	uint8_t done;
+	uint8_t overflow;
+	char text[PROTO_LINE_MAX + 1];
+} proto_line;
+
+uint16_t proto_crc16(uint16_t crc, const uint8_t *data, size_t len);
+
+void proto_reset(proto_parser *p);
+int proto_idle(const proto_parser *p);
+size_t proto_wanted(const proto_parser *p);
+int proto_feed(proto_parser *p, const uint8_t *data, size_t len, size_t *used);
+
+void proto_line_reset(proto_line *l);
+int proto_line_feed(proto_line *l, const uint8_t *data, size_t len, size_t *used);
+
+size_t proto_encode(uint8_t *out, size_t size, uint8_t cmd, uint8_t seq,
+					uint8_t status, const uint8_t *data, uint16_t len);
+
+#endif // PROTO_H
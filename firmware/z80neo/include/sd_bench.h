@@ -0,0 +1,41 @@
+#ifndef SD_BENCH_H
+#define SD_BENCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ff.h"
+#include "tf_card.h"
+
+// SD card throughput benchmark, used to qualify cards for production boards.
+//
+// Each run remounts the card at the given SPI clock and measures the mount
+// time, sequential write and read of a FILE_SIZE_MB test file and random
+// single sector reads inside it.
+
+#define SD_BENCH_FILE "BENCH.DAT"
+
+typedef struct {
+	uint32_t clk_hz;
+	uint32_t mount_us;
+
+	uint32_t write_kbps;
+	uint32_t write_max_us;
+	uint32_t write_min_us;
+
+	uint32_t read_kbps;
+	uint32_t read_max_us;
+	uint32_t read_min_us;
+
+	uint32_t rand_iops;
+	uint32_t rand_avg_us;
+
+	FRESULT fr;
+} sd_bench_result;
+
+FRESULT sd_bench_run(pico_fatfs_spi_config_t *config, uint32_t clk_fast,
+					 sd_bench_result *res);
+
+int sd_bench_format(const sd_bench_result *res, char *out, size_t len);
+
+#endif // SD_BENCH_H
@@ -11,7 +11,7 @@
 #include <stdint.h>
 
 
-static uint8_t pico_font[] = {
+static const uint8_t pico_font[] = {
 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  // Nothing
 0x1e, 0x28, 0x48, 0x88, 0x48, 0x28, 0x1e, 0x00,  //A
 0xfe, 0x92, 0x92, 0x92, 0x92, 0x92, 0xfe, 0x00,  //B
@@ -52,7 +52,7 @@ static uint8_t pico_font[] = {
 };
 
 
-static uint8_t c64_font[] = {
+static const uint8_t c64_font[] = {
 
 /*   */ 0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
 /* ! */ 0x00,0x00,0x00,0x00,0x4f,0x4f,0x00,0x00,
@@ -210,7 +210,7 @@ Architectures
     Any
 */
 
-static uint8_t font[] = {
+static const uint8_t font[] = {
 
   0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     0x00, 0x00, 0x06, 0x5f, 0x5f, 0x06, 0x00, 0x00,
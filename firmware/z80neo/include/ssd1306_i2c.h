@@ -2,6 +2,7 @@
 #define SSD1306_I2C_H
 
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #undef PICO_DEFAULT_I2C_SDA_PIN
@@ -41,8 +42,15 @@
 
 // 400 is usual, but often these can be overclocked to improve display response.
 // Tested at 1000 on both 32 and 84 pixel height devices and it worked.
+// ssd1306_setup() tries SSD1306_I2C_CLK_FAST first and falls back to
+// SSD1306_I2C_CLK when the panel doesn't answer. Set both to 400 to never
+// overclock.
+#ifndef SSD1306_I2C_CLK
 #define SSD1306_I2C_CLK             400
-//#define SSD1306_I2C_CLK             1000
+#endif
+#ifndef SSD1306_I2C_CLK_FAST
+#define SSD1306_I2C_CLK_FAST        1000
+#endif
 
 
 // commands (see datasheet)
@@ -72,11 +80,16 @@
 #define SSD1306_SET_PRECHARGE       _u(0xD9)
 #define SSD1306_SET_COM_PIN_CFG     _u(0xDA)
 #define SSD1306_SET_VCOM_DESEL      _u(0xDB)
+#define SSD1306_NOP                 _u(0xE3)
 
 #define SSD1306_PAGE_HEIGHT         _u(8)
 #define SSD1306_NUM_PAGES           (SSD1306_HEIGHT / SSD1306_PAGE_HEIGHT)
 #define SSD1306_BUF_LEN             (SSD1306_NUM_PAGES * SSD1306_WIDTH)
 
+// DMA stream, a full frame plus the commands and control bytes of a per page
+// update
+#define SSD1306_STREAM_LEN          (SSD1306_BUF_LEN + SSD1306_NUM_PAGES * 16)
+
 #define SSD1306_WRITE_MODE         _u(0xFE)
 #define SSD1306_READ_MODE          _u(0xFF)
 
@@ -94,19 +107,25 @@ struct render_area {
 
 void calc_render_area_buflen(struct render_area *area);
 
+void SSD1306_dma_init();
+bool SSD1306_busy();
+void SSD1306_wait();
+void SSD1306_kick();
+void SSD1306_queue_cmd_list(const uint8_t *cmds, int num);
+void SSD1306_queue_buf(const uint8_t *display_buf, int buflen);
+
 void SSD1306_send_cmd(uint8_t cmd);
 void SSD1306_send_cmd_list(uint8_t *display_buf, int num);
 void SSD1306_send_buf(uint8_t display_buf[], int buflen);
 void SSD1306_init();
 void SSD1306_scroll(bool on);
 
+void render_queue(uint8_t *display_buf, struct render_area *area);
 void render(uint8_t *display_buf, struct render_area *area);
 
 void SetPixel(uint8_t *display_buf, int x,int y, bool on);
 void DrawLine(uint8_t *display_buf, int x0, int y0, int x1, int y1, bool on);
 int GetFontIndex(uint8_t ch);
-uint8_t reverse(uint8_t b);
-void FillReversedCache();
 
 void WriteChar(uint8_t *display_buf, int16_t x, int16_t y, uint8_t ch);
 void WriteString(uint8_t *display_buf, int16_t x, int16_t y, char *str);
@@ -0,0 +1,62 @@
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ff.h"
+
+// SD card storage service.
+//
+// The volume is mounted once and the FATFS object (with its sector window
+// cache) stays resident for the lifetime of the firmware. Callers ask for the
+// mount with storage_mount(), which is a no-op while the card is healthy, and
+// report the result of their own FatFS calls with storage_check() so a removed
+// or failing card gets remounted on the next access.
+
+// physical drive of the card, the only volume
+#define STORAGE_DRIVE 0
+
+FRESULT storage_mount(void);
+void storage_unmount(void);
+bool storage_mounted(void);
+
+FRESULT storage_check(FRESULT fr);
+
+const char *storage_cwd(void);
+
+// Host access.
+//
+// storage_lend() unmounts the volume and hands the card to the host (USB mass
+// storage), storage_mount() fails with FR_NOT_READY until storage_reclaim().
+// FatFS and the host never see the card at the same time.
+
+bool storage_lend(void);
+void storage_reclaim(void);
+bool storage_lent(void);
+
+// Directory index.
+//
+// The matching files of the current directory are scanned once per mount (or
+// after storage_index_invalidate(), e.g. on a write) and kept sorted by name,
+// so the file browser can step through them in O(1).
+
+#define DIR_INDEX_MAX 256
+#define DIR_NAME_LEN 17
+#define DIR_PATTERN_LEN 64 // the whole '|' list given to storage_index()
+
+typedef struct {
+	char name[DIR_NAME_LEN];
+	FSIZE_t size;
+} dir_entry;
+
+int storage_index(const char *pattern);
+const dir_entry *storage_index_entry(int no);
+void storage_index_invalidate(void);
+
+// Bulk loading, see storage_load()
+
+bool storage_contiguous(FIL *fil);
+FRESULT storage_load(FIL *fil, uint8_t *dst, UINT len, UINT *br);
+
+#endif // STORAGE_H
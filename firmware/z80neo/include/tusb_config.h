@@ -26,10 +26,26 @@
 
 // Enable 2 CDC classes
 #define CFG_TUD_CDC             (2)
-// Set CDC FIFO buffer sizes
-#define CFG_TUD_CDC_RX_BUFSIZE  (64)
-#define CFG_TUD_CDC_TX_BUFSIZE  (64)
-#define CFG_TUD_CDC_EP_BUFSIZE  (64)
+// Set CDC FIFO buffer sizes. TinyUSB gives every CDC interface the same
+// FIFOs, so they are sized for the busiest one: the Z80 serial stream on
+// CDC 0, and 1 KB protocol frames on CDC 1.
+#define CFG_TUD_CDC_RX_BUFSIZE  (1024)
+#define CFG_TUD_CDC_TX_BUFSIZE  (1024)
+// Transfer buffer per endpoint, several packets per transfer
+#define CFG_TUD_CDC_EP_BUFSIZE  (512)
+
+// Bulk packet size in the descriptors, the most the bus allows
+#define BULK_EP_PACKET_SIZE     (TUD_OPT_HIGH_SPEED ? 512 : 64)
+
+// Per interface, what the application reads and buffers at a time
+#define CDC_SERIAL_RX_SIZE      CFG_TUD_CDC_RX_BUFSIZE // CDC 0 Z80 serial, power of 2
+#define CDC_SERIAL_TX_SIZE      CFG_TUD_CDC_TX_BUFSIZE // CDC 0 Z80 serial, power of 2
+#define CDC_HOST_RX_SIZE        (64)                   // CDC 1 commands and frames
+
+// SD card as a mass storage device, see usb_msc.c
+#define CFG_TUD_MSC             (1)
+// 8 sectors per transfer, the card gets them as one multi block command
+#define CFG_TUD_MSC_EP_BUFSIZE  (4096)
 
 #ifndef CFG_TUD_ENDPOINT0_SIZE
 #define CFG_TUD_ENDPOINT0_SIZE  (64)
@@ -0,0 +1,29 @@
+#ifndef UNPACK_H
+#define UNPACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Decompressors for the formats z88dk packs with: ZX0 (v2, the default of
+// the zx0 tool) and LZ4, raw blocks or the frames the lz4 tool writes.
+//
+// All of them stop at the end of either buffer, a damaged stream can't write
+// out of dst. Matches are copied a byte at a time so src may sit at the end
+// of dst for in place unpacking. They return the bytes written, or
+// UNPACK_ERROR.
+
+#define UNPACK_ERROR -1
+
+#define UNPACK_ZX0 1
+#define UNPACK_LZ4 2	   // one raw block, needs its exact length
+#define UNPACK_LZ4_FRAME 3 // lz4 tool output
+
+#define LZ4_MAGIC 0x184d2204
+
+int unpack_zx0(const uint8_t *src, size_t src_len, uint8_t *dst, size_t dst_len);
+int unpack_lz4(const uint8_t *src, size_t src_len, uint8_t *dst, size_t dst_len);
+int unpack_lz4_frame(const uint8_t *src, size_t src_len, uint8_t *dst, size_t dst_len);
+
+int unpack(int format, const uint8_t *src, size_t src_len, uint8_t *dst, size_t dst_len);
+
+#endif // UNPACK_H
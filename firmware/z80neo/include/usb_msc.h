@@ -0,0 +1,14 @@
+#ifndef USB_MSC_H
+#define USB_MSC_H
+
+#include <stdbool.h>
+
+// SD card as a USB mass storage device.
+//
+// The drive shows no medium until the card is lent with storage_lend(). The
+// host gives it back by ejecting it, or the firmware takes it with
+// usb_msc_reclaim(), which waits for a transfer in progress to end.
+
+void usb_msc_reclaim(void);
+
+#endif // USB_MSC_H
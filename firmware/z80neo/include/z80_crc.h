@@ -0,0 +1,49 @@
+#ifndef Z80_CRC_H
+#define Z80_CRC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// CRC and checksum engine for the Z80.
+//
+// Runs over a block of RAM in one command, through the DMA sniffer for the
+// CRCs, or over bytes the Z80 writes one by one to the data port. Registers,
+// memory mapped from CRC_BASE:
+//
+//   +0 +1   address      +2  bank, CRC_BANK_RUN the running one
+//   +3 +4   length
+//   +5   W  command      R  status
+//   +6   W  data, one more byte
+//   +7 - +10  result, little endian. Writing it sets the value to carry on
+//             from, e.g. 0 for CRC-16/XMODEM instead of the CCITT 0xFFFF.
+//
+// Command: algorithm in bits 1-0, CRC_RESTART starts it over, CRC_BLOCK runs
+// it over the block (the address moves past it). Algorithms:
+//
+//   CRC_16       CRC-16/CCITT-FALSE, poly 0x1021, from 0xFFFF, not reflected
+//   CRC_32       CRC-32 (zip, ethernet), the check of "123456789" is CBF43926
+//   CRC_FLETCHER Fletcher-16, sum2 << 8 | sum1
+
+#define CRC_BASE 0x00c4
+#define CRC_REGS 11
+
+#define CRC_BANK_RUN 0xff
+
+#define CRC_16 0
+#define CRC_32 1
+#define CRC_FLETCHER 2
+
+#define CRC_ALGO 0x03
+#define CRC_BLOCK (1 << 6)
+#define CRC_RESTART (1 << 7)
+
+#define CRC_BAD_BANK (1 << 6) // status, last block not done
+
+// mem holds banks of bank_size bytes (a power of 2), *run the running bank
+void z80_crc_init(const uint8_t *mem, uint32_t bank_size, uint8_t banks, const uint8_t *run);
+void z80_crc_reset(void);
+
+bool z80_crc_read(uint16_t adr, uint8_t *val);
+bool z80_crc_write(uint16_t adr, uint8_t val);
+
+#endif // Z80_CRC_H
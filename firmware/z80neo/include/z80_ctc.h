@@ -0,0 +1,43 @@
+#ifndef Z80_CTC_H
+#define Z80_CTC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Z80 CTC, counter/timer circuit.
+//
+// Four channels on CTC_CHANNELS consecutive addresses from a base set in the
+// INI, programmed like the Zilog part:
+//
+//   control word (bit 0 = 1)
+//     7 interrupt enable   6 counter mode   5 prescaler 256 (16 when clear)
+//     2 time constant follows   1 software reset
+//   time constant, the byte after a control word with bit 2, 0 means 256
+//   vector (bit 0 = 0, channel 0 only), bits 7-3, the channel goes in 2-1
+//
+// Timers count a CTC_CLOCK reference, not the Z80 clock which is far too slow
+// to time anything, and start as soon as their time constant is loaded (there
+// is no CLK/TRG input). Counters count the zero crossings of the previous
+// channel, the usual ZC/TO to CLK/TRG chain, channel 0 never counts.
+//
+// Each running timer sits on one hardware alarm of TIMER1 that fires only on
+// its zero crossing. A read returns the down counter from values worked out
+// when the channel was programmed, one multiply, nothing to wait for.
+//
+// Interrupts go through the controller (z80_int.h) as sources INT_CTC(n),
+// with the CTC vector.
+
+#define CTC_BASE 0x0090
+#define CTC_CHANNELS 4
+#define CTC_CLOCK 1000000
+
+// shortest timer period in us, faster ones are stretched to it
+#define CTC_MIN_US 20
+
+void z80_ctc_init(uint16_t base, uint32_t clock_hz);
+void z80_ctc_reset(void);
+
+bool z80_ctc_read(uint16_t adr, uint8_t *val);
+bool z80_ctc_write(uint16_t adr, uint8_t val);
+
+#endif // Z80_CTC_H
@@ -0,0 +1,46 @@
+#ifndef Z80_DMA_H
+#define Z80_DMA_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Block copy, fill and compare on the Z80 RAM, for LDIR and friends.
+//
+// The Z80 loads the registers and writes a command, the operation is done on
+// ram[] before the write cycle ends so the status is final by the next
+// instruction. Registers, memory mapped from DMA_BASE:
+//
+//   +0 +1   source address        +2  source bank
+//   +3 +4   destination address   +5  destination bank
+//   +6 +7   length, 0 does nothing
+//   +8      fill value
+//   +9   W  command               R  status
+//   +10 +11 R  compare, offset of the first difference (length if equal)
+//
+// A bank of DMA_BANK_RUN means the bank the Z80 is running. Addresses wrap
+// inside the bank. Like LDIR, a copy leaves source and destination one past
+// the block and a destination just above an overlapping source repeats the
+// first bytes.
+
+#define DMA_BASE 0x00a0
+#define DMA_REGS 12
+
+#define DMA_BANK_RUN 0xff
+
+#define DMA_COPY 1
+#define DMA_FILL 2
+#define DMA_COMPARE 3
+
+#define DMA_EQUAL (1 << 0)	   // last compare matched
+#define DMA_BAD_BANK (1 << 6) // last command not done, no such bank
+
+// mem holds banks of bank_size bytes (a power of 2), *run the running bank,
+// writes are bracketed by *seq like the bus writes
+void z80_dma_init(uint8_t *mem, uint32_t bank_size, uint8_t banks,
+				  const uint8_t *run, volatile uint32_t *seq);
+void z80_dma_reset(void);
+
+bool z80_dma_read(uint16_t adr, uint8_t *val);
+bool z80_dma_write(uint16_t adr, uint8_t val);
+
+#endif // Z80_DMA_H
@@ -0,0 +1,58 @@
+#ifndef Z80_INT_H
+#define Z80_INT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Z80 interrupt controller.
+//
+// Collects interrupt sources into /INT and answers the acknowledge cycle
+// (/M1 with /IORQ) with an IM2 vector: the vector register with the number of
+// the highest priority source (lowest bit) in bits 1-3. Level sources are
+// active as long as their condition holds, the others stay pending until
+// their acknowledge. /NMI is pulsed on request.
+//
+// Registers, memory mapped from INT_BASE like the serial port:
+//
+//   +0  W enable mask             R pending mask (enabled or not)
+//   +1  W vector                  R vector
+//   +2  W timer period, 10 ms     R last button pressed (button_state)
+//       units, 0 stops it
+//
+// Everything is cleared when the Z80 is reset or its program is swapped.
+
+#define INT_BASE 0x0088
+#define INT_REGS 3
+
+#define INT_SOURCES 8
+
+#define INT_RX (1 << 0)		// serial byte waiting, level
+#define INT_TX (1 << 1)		// serial output sent, level
+#define INT_TIMER (1 << 2)	// timer period elapsed
+#define INT_BUTTON (1 << 3) // button pressed
+
+// CTC channels 0-3, sources 4-7, z80_ctc.h
+#define INT_CTC_SRC 4
+#define INT_CTC(n) (1 << (INT_CTC_SRC + (n)))
+
+// -1 for a line that isn't wired, both driven open drain
+void z80_int_init(int int_gpio, int nmi_gpio);
+void z80_int_reset(void);
+
+void z80_int_raise(uint8_t sources);
+void z80_int_levels(uint8_t sources);
+void z80_int_button(uint8_t button);
+
+// For devices with their own vector and enable bits (the CTC): sources turned
+// on or off in the enable mask, and a vector that replaces the computed one
+// until the Z80 is reset.
+void z80_int_mask(uint8_t sources, bool on);
+void z80_int_vector(int src, uint8_t vec);
+
+uint8_t z80_int_ack(void);
+void z80_int_nmi(uint32_t us);
+
+bool z80_int_read(uint16_t adr, uint8_t *val);
+bool z80_int_write(uint16_t adr, uint8_t val);
+
+#endif // Z80_INT_H
@@ -0,0 +1,44 @@
+#ifndef Z80_MATH_H
+#define Z80_MATH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Math coprocessor for the Z80.
+//
+// Two 32 bit operands, an opcode and a 64 bit result, little endian, memory
+// mapped from MATH_BASE. The operation runs while the opcode is written, the
+// result is there for the next read.
+//
+//   +0 - +3    A
+//   +4 - +7    B
+//   +8      W  opcode             R  status
+//   +9 - +16   result, low word first: product, or quotient then remainder,
+//              or root then remainder
+//
+// 16 bit operations use the low half of A and B. Division by zero, or a
+// quotient that doesn't fit, sets MATH_ERROR and leaves a zero result.
+
+#define MATH_BASE 0x00b0
+#define MATH_REGS 17
+
+#define MATH_MUL16 1  // A * B, 32 bit
+#define MATH_MULS16 2 // signed
+#define MATH_MUL32 3  // A * B, 64 bit
+#define MATH_MULS32 4 // signed
+#define MATH_DIV16 5  // A / B, A % B
+#define MATH_DIVS16 6 // signed, remainder takes the sign of A
+#define MATH_DIV32 7
+#define MATH_DIVS32 8
+#define MATH_SQRT 9	   // floor(sqrt(A)), A - root^2
+#define MATH_FIXMUL 10 // 16.16 signed A * B
+#define MATH_FIXDIV 11 // 16.16 signed A / B
+
+#define MATH_ERROR (1 << 0)
+
+void z80_math_reset(void);
+
+bool z80_math_read(uint16_t adr, uint8_t *val);
+bool z80_math_write(uint16_t adr, uint8_t val);
+
+#endif // Z80_MATH_H
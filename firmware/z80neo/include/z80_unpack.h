@@ -0,0 +1,42 @@
+#ifndef Z80_UNPACK_H
+#define Z80_UNPACK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Decompression device for the Z80, unpack.h formats.
+//
+// The Z80 points it at packed data and a destination and writes the format,
+// the data is unpacked into ram[] before the write cycle ends. Registers,
+// memory mapped from UNPACK_BASE:
+//
+//   +0 +1   source address        +2  source bank
+//   +3 +4   destination address   +5  destination bank
+//   +6   W  format, starts it     R  status
+//   +7 +8   R  bytes unpacked, 0 with a clear status is nothing, or all
+//              65536 of a bank unpacked from destination 0
+//   +9 +10  source length, LZ4 raw blocks need it, 0 is up to the end of
+//           the bank
+//   +11 - +14  R  time it took in us, for benchmarks
+//
+// A bank of UNPACK_BANK_RUN is the running one. Neither side wraps, unpacking
+// stops with UNPACK_FAILED at the end of the bank.
+
+#define UNPACK_BASE 0x00d0
+#define UNPACK_REGS 15
+
+#define UNPACK_BANK_RUN 0xff
+
+#define UNPACK_FAILED (1 << 0)	// damaged data or no room
+#define UNPACK_BAD_BANK (1 << 6) // not done, no such bank
+
+// mem holds banks of bank_size bytes, *run the running bank, writes are
+// bracketed by *seq like the bus writes
+void z80_unpack_init(uint8_t *mem, uint32_t bank_size, uint8_t banks,
+					 const uint8_t *run, volatile uint32_t *seq);
+void z80_unpack_reset(void);
+
+bool z80_unpack_read(uint16_t adr, uint8_t *val);
+bool z80_unpack_write(uint16_t adr, uint8_t val);
+
+#endif // Z80_UNPACK_H
@@ -0,0 +1,180 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <pico/stdlib.h>
+#include <pico/time.h>
+#include <hardware/adc.h>
+
+#include "buttons.h"
+
+// Slowest free running rate, 48 MHz / 65536, about 730 samples per second,
+// so a tick finds 3 or 4 of them and the FIFO never overflows
+#define ADC_CLKDIV 65535
+
+static button_classifier classifier = NULL;
+static volatile button_hook press_hook = NULL;
+
+static alarm_pool_t *pool = NULL;
+static repeating_timer_t timer;
+
+static volatile uint16_t last_adc = 0;
+static volatile uint32_t ticks = 0;
+
+// debouncer, only touched by the timer interrupt
+static button_state candidate = NONE;
+static int stable = 0;
+static uint32_t pressed_at = 0;
+static uint32_t next_repeat = 0;
+static bool long_sent = false;
+
+static volatile button_state state = NONE;
+
+// single producer (timer interrupt), single consumer (UI), same core
+static button_event queue[BUTTON_QUEUE_LEN];
+static volatile uint8_t head = 0;
+static volatile uint8_t tail = 0;
+
+static void push(button_event_type type, button_state button, uint32_t held) {
+
+	uint8_t next = (head + 1) % BUTTON_QUEUE_LEN;
+
+	// nobody is reading, drop the event rather than the older ones
+	if (next == tail)
+		return;
+
+	queue[head].type = type;
+	queue[head].button = button;
+	queue[head].held_us = held;
+
+	head = next;
+}
+
+//
+// Sampling
+//
+
+static bool sample(repeating_timer_t *rt) {
+
+	uint32_t sum = 0;
+	uint32_t n = 0;
+	uint32_t now = time_us_32();
+
+	if (pool) {
+		while (!adc_fifo_is_empty()) {
+			sum += adc_fifo_get();
+			n++;
+		}
+	} else {
+		sum = adc_read();
+		n = 1;
+	}
+
+	if (n)
+		last_adc = sum / n;
+
+	button_state raw = classifier(last_adc);
+
+	if (raw == candidate) {
+		if (stable < BUTTON_DEBOUNCE)
+			stable++;
+	} else {
+		candidate = raw;
+		stable = 1;
+	}
+
+	if (stable == BUTTON_DEBOUNCE && candidate != state) {
+
+		if (state != NONE)
+			push(BUTTON_RELEASE, state, now - pressed_at);
+
+		state = candidate;
+
+		if (state != NONE) {
+			pressed_at = now;
+			long_sent = false;
+			push(BUTTON_PRESS, state, 0);
+			if (press_hook)
+				press_hook(state);
+		}
+	}
+
+	if (state != NONE) {
+
+		uint32_t held = now - pressed_at;
+
+		if (!long_sent && held >= BUTTON_LONG_US) {
+			long_sent = true;
+			next_repeat = now + BUTTON_REPEAT_US;
+			push(BUTTON_LONG, state, held);
+		} else if (long_sent && (int32_t)(now - next_repeat) >= 0) {
+			next_repeat += BUTTON_REPEAT_US;
+			push(BUTTON_REPEAT, state, held);
+		}
+	}
+
+	ticks++;
+
+	return true;
+}
+
+void buttons_init(uint adc_input, button_classifier classify) {
+
+	classifier = classify;
+
+	adc_select_input(adc_input);
+}
+
+void buttons_start(void) {
+
+	adc_fifo_setup(true, false, 1, false, false);
+	adc_set_clkdiv(ADC_CLKDIV);
+	adc_fifo_drain();
+	adc_run(true);
+
+	// our own pool so the interrupt lands on this core and not on core0,
+	// which is busy with the bus
+	pool = alarm_pool_create_with_unused_hardware_alarm(4);
+	alarm_pool_add_repeating_timer_us(pool, -BUTTON_SAMPLE_US, sample, NULL, &timer);
+}
+
+//
+// Consumer side
+//
+
+button_state buttons_state(void) { return state; }
+
+uint16_t buttons_adc(void) { return last_adc; }
+
+bool buttons_get(button_event *ev) {
+
+	if (tail == head)
+		return false;
+
+	*ev = queue[tail];
+	tail = (tail + 1) % BUTTON_QUEUE_LEN;
+
+	return true;
+}
+
+void buttons_flush(void) { tail = head; }
+
+// Sleep until a sample newer than the one seen on the previous call. Before
+// buttons_start() the caller's sleep drives the sampling instead.
+void buttons_sleep(void) {
+
+	static uint32_t seen = 0;
+
+	if (!pool) {
+		sleep_us(BUTTON_SAMPLE_US);
+		sample(NULL);
+		seen = ticks;
+		return;
+	}
+
+	while (ticks == seen)
+		__wfi();
+
+	seen = ticks;
+}
+
+void buttons_on_press(button_hook hook) { press_hook = hook; }
@@ -0,0 +1,124 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <pico/stdlib.h>
+#include <pico/time.h>
+
+#include "ssd1306_i2c.h"
+#include "display.h"
+
+// Two framebuffers: the UI draws into the back one, the front one holds what
+// the panel shows. Both stay word aligned, as buf32 was.
+static uint32_t frame32[2][(SSD1306_BUF_LEN + 3) / 4];
+
+static uint8_t *const frame = (uint8_t *)frame32[0];
+static uint8_t *const shown = (uint8_t *)frame32[1];
+static bool shown_valid = false;
+
+static bool pending = false;
+static uint64_t last_flush = 0;
+
+uint8_t *display_init(void) {
+	memset(frame32, 0, sizeof(frame32));
+	shown_valid = false;
+	pending = true;
+	return frame;
+}
+
+void display_invalidate(void) {
+	shown_valid = false;
+	pending = true;
+}
+
+//
+// Flush
+//
+// The changed spans are queued for DMA and then copied to the front buffer,
+// so the front buffer swaps to the new frame as soon as its transfer is
+// queued and the back buffer is free for the next frame right away.
+
+void display_flush(void) {
+
+	struct render_area area;
+
+	pending = false;
+	last_flush = time_us_64();
+
+	for (int page = 0; page < SSD1306_NUM_PAGES; page++) {
+
+		uint8_t *row = frame + page * SSD1306_WIDTH;
+		uint8_t *old = shown + page * SSD1306_WIDTH;
+		int first = 0;
+		int last = SSD1306_WIDTH - 1;
+
+		if (shown_valid) {
+
+			while (first < SSD1306_WIDTH && row[first] == old[first])
+				first++;
+
+			// page unchanged
+			if (first == SSD1306_WIDTH)
+				continue;
+
+			while (row[last] == old[last])
+				last--;
+		}
+
+		area.start_col = first;
+		area.end_col = last;
+		area.start_page = page;
+		area.end_page = page;
+		calc_render_area_buflen(&area);
+
+		render_queue(row + first, &area);
+
+		memcpy(old + first, row + first, last - first + 1);
+	}
+
+	shown_valid = true;
+
+	// all pages go out in one DMA stream, we don't wait for it
+	SSD1306_kick();
+}
+
+//
+// Pacing
+//
+
+void display_request(void) {
+
+	pending = true;
+
+	if (time_us_64() - last_flush >= DISPLAY_FRAME_US)
+		display_flush();
+}
+
+// True once per frame interval, when the previous frame is off the wire.
+// Widgets that change all the time (bus state) are drawn only then.
+bool display_frame_due(void) {
+	return time_us_64() - last_flush >= DISPLAY_FRAME_US && !SSD1306_busy();
+}
+
+bool display_tick(void) {
+
+	if (!pending || time_us_64() - last_flush < DISPLAY_FRAME_US)
+		return false;
+
+	// previous frame still on the wire, try again on the next tick
+	if (SSD1306_busy())
+		return false;
+
+	display_flush();
+
+	return true;
+}
+
+// For messages that stay up for a while, don't leave them pending
+void display_sleep_ms(uint32_t ms) {
+
+	if (pending)
+		display_flush();
+
+	sleep_ms(ms);
+}
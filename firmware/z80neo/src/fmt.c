@@ -0,0 +1,29 @@
+#include <stdint.h>
+
+#include "fmt.h"
+
+static const char hex_digits[16] = "0123456789abcdef";
+
+// digits is the exact number of nibbles written, like "%0*x" truncated
+char *fmt_hex(char *p, uint32_t v, int digits) {
+
+	for (int i = digits - 1; i >= 0; i--) {
+		p[i] = hex_digits[v & 0xF];
+		v >>= 4;
+	}
+
+	p += digits;
+	*p = 0;
+
+	return p;
+}
+
+char *fmt_str(char *p, const char *s) {
+
+	while (*s)
+		*p++ = *s++;
+
+	*p = 0;
+
+	return p;
+}
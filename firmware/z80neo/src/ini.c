@@ -0,0 +1,76 @@
+#include <ctype.h>
+#include <stddef.h>
+
+#include "ini.h"
+
+static char *trim(char *start, char *end) {
+
+	while (start < end && isspace((unsigned char)*start))
+		start++;
+	while (end > start && isspace((unsigned char)end[-1]))
+		end--;
+
+	*end = 0;
+
+	return start;
+}
+
+// Returns the number of lines handed to the handler
+int ini_parse(char *text, size_t len, ini_handler handler, void *user) {
+
+	char *p = text;
+	char *end = text + len;
+	int line = 0;
+	int count = 0;
+
+	while (p < end) {
+
+		char *eol = p;
+		char *eq = NULL;
+
+		while (eol < end && *eol != '\n' && *eol != '\r' && *eol) {
+			if (*eol == '=' && !eq)
+				eq = eol;
+			eol++;
+		}
+
+		char term = eol < end ? *eol : 0;
+		char *next = eol < end ? eol + 1 : end;
+
+		line++;
+
+		char *s = trim(p, eol);
+
+		if (*s && *s != ';' && *s != '#' && *s != '[') {
+
+			if (eq) {
+				*eq = 0;
+				handler(trim(s, eq), trim(eq + 1, eol), line, user);
+			} else
+				handler(NULL, s, line, user);
+
+			count++;
+		}
+
+		// "\r\n" only counts as one line
+		if (term == '\r' && next < end && *next == '\n')
+			next++;
+
+		p = next;
+	}
+
+	return count;
+}
+
+// Case insensitive key compare
+int ini_key_is(const char *key, const char *name) {
+
+	while (*key && *name) {
+		if (tolower((unsigned char)*key) != tolower((unsigned char)*name))
+			return 0;
+		key++;
+		name++;
+	}
+
+	return *key == *name;
+}
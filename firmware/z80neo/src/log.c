@@ -0,0 +1,242 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <hardware/sync.h>
+#include <pico/stdlib.h>
+
+#include "ff.h"
+#include "storage.h"
+
+#include "log.h"
+
+static const char *const formats[LOG_EVENTS] = {
+#define LOG_EVENT(name, level, fmt) fmt,
+#include "log_events.h"
+#undef LOG_EVENT
+};
+
+static const char *const levels[] = {"D", "I", "W", "E"};
+
+// Bounded multi producer ring, one per core: the producers are that core and
+// its interrupts. A slot is free for position pos when its seq is pos, and
+// holds the record for pos when seq is pos + 1. A producer claims a position
+// with a compare and swap on head and publishes with seq, nobody waits for
+// anybody: an interrupted producer only holds back the reader, and a full
+// ring drops the record.
+
+typedef struct {
+	uint32_t seq;
+	log_record rec;
+} log_slot;
+
+typedef struct {
+	log_slot slots[LOG_SLOTS];
+	uint32_t head;	  // next position to claim
+	uint32_t tail;	  // next position to read, core0 only
+	uint32_t dropped; // records lost to a full ring
+} log_ring;
+
+static log_ring rings[2];
+
+_Static_assert(sizeof(log_record) == 16, "log_record is a wire format");
+
+void log_init(void) {
+	for (int c = 0; c < 2; c++) {
+		for (uint32_t i = 0; i < LOG_SLOTS; i++)
+			rings[c].slots[i].seq = i;
+	}
+}
+
+void log_put(uint16_t id, uint8_t level, uint32_t a, uint32_t b) {
+
+	uint core = get_core_num();
+	log_ring *ring = &rings[core];
+	uint32_t pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+	log_slot *s;
+
+	while (true) {
+
+		s = &ring->slots[pos & (LOG_SLOTS - 1)];
+		int32_t dif = (int32_t)(__atomic_load_n(&s->seq, __ATOMIC_ACQUIRE) - pos);
+
+		if (dif == 0) {
+			if (__atomic_compare_exchange_n(&ring->head, &pos, pos + 1, true,
+											__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		} else if (dif < 0) {
+			__atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+			return;
+		} else
+			pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+	}
+
+	s->rec.time_us = time_us_32();
+	s->rec.id = id;
+	s->rec.level = level;
+	s->rec.core = core;
+	s->rec.a = a;
+	s->rec.b = b;
+
+	__atomic_store_n(&s->seq, pos + 1, __ATOMIC_RELEASE);
+}
+
+static log_slot *ring_peek(log_ring *ring) {
+
+	log_slot *s = &ring->slots[ring->tail & (LOG_SLOTS - 1)];
+
+	if (__atomic_load_n(&s->seq, __ATOMIC_ACQUIRE) != ring->tail + 1)
+		return NULL;
+
+	return s;
+}
+
+// Oldest record of both cores, false when there is none. core0 only.
+bool log_get(log_record *r) {
+
+	for (int c = 0; c < 2; c++) {
+
+		uint32_t lost = __atomic_exchange_n(&rings[c].dropped, 0, __ATOMIC_RELAXED);
+
+		if (lost) {
+			r->time_us = time_us_32();
+			r->id = LOG_ID_DROPPED;
+			r->level = LOG_LEVEL_DROPPED;
+			r->core = c;
+			r->a = lost;
+			r->b = c;
+			return true;
+		}
+	}
+
+	log_slot *s0 = ring_peek(&rings[0]);
+	log_slot *s1 = ring_peek(&rings[1]);
+	int c;
+
+	if (s0 && s1)
+		c = (int32_t)(s1->rec.time_us - s0->rec.time_us) < 0;
+	else if (s0 || s1)
+		c = s1 != NULL;
+	else
+		return false;
+
+	log_slot *s = c ? s1 : s0;
+	log_ring *ring = &rings[c];
+
+	*r = s->rec;
+
+	__atomic_store_n(&s->seq, ring->tail + LOG_SLOTS, __ATOMIC_RELEASE);
+	ring->tail++;
+
+	return true;
+}
+
+// One line of text, returns its length
+int log_format(const log_record *r, char *out, size_t len) {
+
+	int n = snprintf(out, len, "%6lu.%06lu %s%u ", (unsigned long)(r->time_us / 1000000),
+					 (unsigned long)(r->time_us % 1000000),
+					 r->level < count_of(levels) ? levels[r->level] : "?", r->core);
+
+	if (n < 0 || (size_t)n >= len - 3)
+		n = 0;
+
+	if (r->id < LOG_EVENTS)
+		n += snprintf(out + n, len - n, formats[r->id], (unsigned long)r->a,
+					  (unsigned long)r->b);
+	else
+		n += snprintf(out + n, len - n, "? %u %08lx %08lx", r->id,
+					  (unsigned long)r->a, (unsigned long)r->b);
+
+	if ((size_t)n > len - 3)
+		n = len - 3;
+
+	out[n++] = '\r';
+	out[n++] = '\n';
+	out[n] = 0;
+
+	return n;
+}
+
+//
+// Rotating file, core0 to core1
+//
+
+static log_record file_buf[LOG_FILE_RECORDS];
+static volatile uint32_t file_head = 0; // core0
+static volatile uint32_t file_tail = 0; // core1
+
+void log_file_put(const log_record *r) {
+
+	// full, core1 hasn't had the card for a while
+	if (file_head - file_tail >= LOG_FILE_RECORDS)
+		return;
+
+	file_buf[file_head & (LOG_FILE_RECORDS - 1)] = *r;
+	__dmb();
+	file_head++;
+}
+
+static FRESULT file_rotate(FIL *fil) {
+
+	FRESULT fr;
+
+	f_close(fil);
+
+	f_unlink(LOG_FILE_OLD);
+	fr = f_rename(LOG_FILE, LOG_FILE_OLD);
+	if (fr != FR_OK)
+		return fr;
+
+	return f_open(fil, LOG_FILE, FA_CREATE_ALWAYS | FA_WRITE);
+}
+
+// Appends what core0 handed over, once a sector's worth is waiting or it has
+// waited LOG_FILE_FLUSH_US. Quiet when the card is missing or lent to the PC.
+void log_file_task(void) {
+
+	static uint32_t last_us = 0;
+
+	uint32_t n = file_head - file_tail;
+	uint32_t now = time_us_32();
+
+	if (!n || (n * sizeof(log_record) < FF_MIN_SS && now - last_us < LOG_FILE_FLUSH_US))
+		return;
+
+	last_us = now;
+
+	if (storage_mount() != FR_OK)
+		return;
+
+	FIL fil;
+	UINT bw;
+	FRESULT fr = storage_check(f_open(&fil, LOG_FILE, FA_OPEN_APPEND | FA_WRITE));
+	if (fr != FR_OK)
+		return;
+
+	if (f_size(&fil) >= LOG_FILE_MAX) {
+		fr = storage_check(file_rotate(&fil));
+		if (fr != FR_OK)
+			return;
+	}
+
+	while (n) {
+
+		uint32_t pos = file_tail & (LOG_FILE_RECORDS - 1);
+		uint32_t run = LOG_FILE_RECORDS - pos;
+		if (run > n)
+			run = n;
+
+		fr = storage_check(f_write(&fil, &file_buf[pos], run * sizeof(log_record), &bw));
+		if (fr != FR_OK)
+			break;
+
+		__dmb();
+		file_tail += run;
+		n -= run;
+	}
+
+	f_close(&fil);
+}
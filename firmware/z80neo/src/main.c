@@ -1,9 +1,11 @@
+#include <ctype.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 
 
 #include <bsp/board_api.h>
@@ -15,6 +17,7 @@
 #include <hardware/gpio.h>
 #include <hardware/pwm.h>
 #include <hardware/spi.h>
+#include <hardware/sync.h>
 #include <hardware/vreg.h>
 #include <pico/multicore.h>
 #include <pico/stdlib.h>
@@ -22,26 +25,51 @@
 
 // Screen
 #include "ssd1306_i2c.h"
+#include "display.h"
+#include "fmt.h"
+#include "buttons.h"
 
 // SD Card
 #include "ff.h"
 #include "tf_card.h"
+#include "storage.h"
+#include "sd_bench.h"
+#include "ini.h"
+#include "usb_msc.h"
+
+// Z80 devices
+#include "z80_int.h"
+#include "z80_ctc.h"
+#include "z80_dma.h"
+#include "z80_math.h"
+#include "z80_crc.h"
+#include "z80_unpack.h"
+#include "unpack.h"
+
+// Host protocol
+#include "proto.h"
+#include "log.h"
 
 #undef CLK_SLOW_DEFAULT
 #undef CLK_FAST_DEFAULT
 
 #define CLK_SLOW_DEFAULT (100 * KHZ)
-#define CLK_FAST_DEFAULT (10 * MHZ)
+// 25 MHz is the top of the SD default speed mode every card supports in SPI
+#define CLK_FAST_DEFAULT (25 * MHZ)
 
 
 #define SERIAL_PORT 0x80
 
-// Buffer for received data
-uint8_t rx_buffer[CFG_TUD_CDC_RX_BUFSIZE];
-uint8_t tx_buffer[CFG_TUD_CDC_TX_BUFSIZE];
-uint8_t rx_head = 0;
-uint8_t rx_tail = 0;
-bool rx_data_available = false;
+// Z80 serial port on CDC 0. The bus ISR takes bytes out of serial_rx and
+// puts them into serial_tx, serial_task() moves them from and to the CDC
+// FIFOs. Both run on core0, one producer and one consumer per ring, indices
+// run free and are masked on use.
+uint8_t serial_rx[CDC_SERIAL_RX_SIZE];
+uint8_t serial_tx[CDC_SERIAL_TX_SIZE];
+volatile uint16_t serial_rx_head = 0; // serial_task()
+volatile uint16_t serial_rx_tail = 0; // bus ISR
+volatile uint16_t serial_tx_head = 0; // bus ISR
+volatile uint16_t serial_tx_tail = 0; // serial_task()
 
 uint8_t read_buffer[256];
 
@@ -60,57 +88,37 @@ struct render_area frame_area = {
 	end_page : SSD1306_NUM_PAGES - 1
 };
 
-// Set PRE_ALLOCATE true to pre-allocate file clusters.
-const bool PRE_ALLOCATE = true;
-
-// Set SKIP_FIRST_LATENCY true if the first read/write to the SD can
-// be avoid by writing a file header or reading the first record.
-const bool SKIP_FIRST_LATENCY = true;
-
-// Size of read/write.
-#define BUF_SIZE 512
-
-// File size in MB where MB = 1,000,000 bytes.
-const uint32_t FILE_SIZE_MB = 5;
-
-// Write pass count.
-const uint8_t WRITE_COUNT = 2;
-
-// Read pass count.
-const uint8_t READ_COUNT = 2;
-
-//==============================================================================
-// End of configuration constants.
-//------------------------------------------------------------------------------
-// File size in bytes.
-const uint32_t FILE_SIZE = 1000000UL * FILE_SIZE_MB;
-
-// Insure 4-byte alignment.
-
-uint32_t buf32[(BUF_SIZE + 3) / 4];
-
-uint8_t *buf = (uint8_t *)buf32;
-
-uint8_t *disp_buf_0 = (uint8_t *)buf32;
-uint8_t *disp_buf_1 = (uint8_t *)buf32;
-uint8_t *disp_buf_2 = (uint8_t *)buf32;
-uint8_t *disp_buf_3 = (uint8_t *)buf32;
+// Draw buffer, owned by the display layer, see display_init()
+uint8_t *buf = NULL;
 
 void show_info(void);
 
 void reset_release(void);
 void reset_hold(void);
+void io_reset(void);
+
+bool z80_can_reset(void);
+uint32_t reset_time_us(void);
+void z80_reset(void);
+void z80_swap_begin(void);
+void z80_swap_end(void);
+void z80_run_bank(uint8_t bank);
+void host_command_run(void);
+
+void enable_clk(uint slice_num, bool enable);
 
 void show_error_and_halt(char *err);
 void show_error(int b, int a, char *err);
 void show_error_wait_for_button(char *err);
 
-char *init_and_mount_sd_card(void);
+char const *init_and_mount_sd_card(void);
 
-void load_file(bool quiet);
+bool load_file(uint8_t bank, bool quiet);
 
 void load();
 void save();
+void sd_test(void);
+void usb_disk(void);
 
 //
 //
@@ -123,8 +131,14 @@ void save();
 //
 
 #define FILE_LENGTH 17
-#define FILE_BUFF_SIZE 64
-#define FILE_EXT "*.HEX"
+#define FILE_EXT "*.HEX|*.BIN|*.ZX0|*.LZ4"
+#define BIN_EXT ".BIN"
+#define ZX0_EXT ".ZX0" // packed binary images, unpack.h
+#define LZ4_EXT ".LZ4"
+
+// HEX files are streamed through this buffer, a multiple of the sector size so
+// FatFS reads straight into it with multi block transfers
+#define LOAD_CHUNK_SIZE (8 * 512)
 
 //
 //
@@ -152,6 +166,32 @@ volatile uint16_t BACK_ADC = 0x510;
 volatile uint16_t DOWN_ADC = 0x220;
 volatile uint16_t UP_ADC = 0x100;
 
+// Z80NEO.INI extras
+
+#define INI_FILE "Z80NEO.INI"
+#define INI_MAX_SIZE 2048
+
+#define DEVICE_SERIAL (1 << 0)
+#define DEVICE_INT (1 << 1) // interrupt controller, z80_int.h
+#define DEVICE_CTC (1 << 2) // counter/timer, z80_ctc.h
+#define DEVICE_DMA (1 << 3) // block copy, z80_dma.h
+#define DEVICE_MATH (1 << 4) // coprocessor, z80_math.h
+#define DEVICE_CRC (1 << 5) // CRC engine, z80_crc.h
+#define DEVICE_UNPACK (1 << 6) // decompression, z80_unpack.h
+
+volatile bool VERBOSE_INI = false;	  // show every setting while booting
+volatile uint32_t Z80_CLOCK = 50;	  // Hz
+volatile uint32_t DEVICES = DEVICE_SERIAL;
+volatile uint16_t SERIAL_RX_SIZE = CDC_SERIAL_RX_SIZE; // bytes buffered ahead of the Z80
+volatile uint16_t CTC_PORT = CTC_BASE;
+volatile uint32_t CTC_HZ = CTC_CLOCK;
+
+// where the log goes on CDC 1, and a copy on the SD card, see log.h
+typedef enum { LOG_OUT_OFF, LOG_OUT_TEXT, LOG_OUT_RAW } log_output;
+
+volatile log_output LOG_OUTPUT = LOG_OUT_TEXT;
+volatile bool LOG_TO_FILE = false;
+
 //
 //
 //
@@ -163,7 +203,6 @@ volatile uint16_t UP_ADC = 0x100;
 #define DISPLAY_DELAY_SHORT 100
 
 #define BLINK_DELAY (100 * 1000)
-#define LONG_BUTTON_DELAY (400 * 1000)
 
 typedef char display_line[17];
 display_line file;
@@ -175,8 +214,6 @@ const char *hexStringChar[] = {"0", "1", "2", "3", "4", "5", "6", "7",
 
 char text_buffer[TEXT_BUFFER_SIZE];
 
-char tbmon_text_buffer[4][17];
-
 char line1[TEXT_BUFFER_SIZE];
 char line2[TEXT_BUFFER_SIZE];
 char line3[TEXT_BUFFER_SIZE];
@@ -220,10 +257,68 @@ char *screen[LINES] = {line1, line2, line3, line4};
 #define WR_INPUT 27
 
 #define ADC_KEYS_INPUT 28
+#define ADC_KEYS_CHANNEL 2
+
+// /RESET and /BUSREQ are not routed to the Pico on the current board. On
+// boards that have them define the GPIOs here, the outputs are driven open
+// drain (low or released to the board pull-up), /BUSACK is read back.
+// #define RESET_OUT <gpio>
+// #define BUSREQ_OUT <gpio>
+// #define BUSACK_INPUT <gpio>
+
+// Same for the interrupt lines, /INT and /NMI open drain, /M1 to tell the
+// interrupt acknowledge from other /IORQ cycles. Without /M1 the Z80 can use
+// the controller registers but never takes an interrupt.
+// #define INT_OUT <gpio>
+// #define NMI_OUT <gpio>
+// #define M1_INPUT <gpio>
+
+#ifndef INT_OUT
+#define INT_OUT -1
+#endif
+#ifndef NMI_OUT
+#define NMI_OUT -1
+#endif
 
 
 const uint8_t LED_PIN = PICO_DEFAULT_LED_PIN;
 
+//
+// SD Card
+//
+
+pico_fatfs_spi_config_t sd_config = {
+	spi0, // if unmatched SPI pin assignments with spi0/spi1 or explicitly
+		  // designated as NULL, SPI PIO will be configured
+	CLK_SLOW_DEFAULT, CLK_FAST_DEFAULT,
+	PIN_SPI1_MISO,	 // SPIx_RX
+	PIN_SPI1_SCK,	 // SPIx_CS
+	PIN_SPI1_CS,	 // SPIx_SCK
+	PIN_SPI1_MOSI,	 // SPIx_TX
+	true // use internal pullup
+};
+
+// SPI clocks the SD benchmark walks through
+const uint32_t SD_BENCH_CLOCKS[] = {5 * MHZ, 10 * MHZ, 20 * MHZ, CLK_FAST_DEFAULT};
+
+// Text queued by core1 for core0 to send on CDC 1
+#define REPORT_BUFFER_SIZE 1024
+
+char report_buffer[REPORT_BUFFER_SIZE];
+volatile uint32_t report_len = 0;
+
+volatile bool bench_requested = false;
+
+// Commands from the host on CDC 1, see host_command_run()
+typedef enum { HOST_NONE, HOST_RESET, HOST_RUN, HOST_LOAD, HOST_BANK } host_command;
+
+volatile host_command host_cmd = HOST_NONE;
+volatile uint8_t host_bank = 0;
+char host_file[FILE_LENGTH];
+
+// set for commands that came in a frame, core0 answers those itself
+volatile bool host_quiet = false;
+
 //
 //
 //
@@ -232,11 +327,33 @@ const uint8_t LED_PIN = PICO_DEFAULT_LED_PIN;
 
 static uint8_t cur_bank = 0;
 
+volatile uint8_t BOOT_BANKS = MAX_BANKS; // banks preloaded from the INI
+
 uint8_t ram[MAX_BANKS][(uint32_t)RAM_SIZE] = {};
 uint8_t sdram[(uint32_t)SD_RAM_SIZE] = {};
 
 uint16_t tbmon_idx = 0;
 
+// Bus writes into ram[] are bracketed by ram_seq, odd while a write is in
+// progress, so core1 can copy a consistent window of the running bank.
+volatile uint32_t ram_seq = 0;
+
+void ram_snapshot(uint8_t bank, uint16_t adr, uint8_t *dst, int len) {
+
+	uint32_t seq;
+
+	do {
+		while ((seq = ram_seq) & 1)
+			tight_loop_contents();
+		__dmb();
+
+		for (int i = 0; i < len; i++)
+			dst[i] = ram[bank][(adr + i) & (RAM_SIZE - 1)];
+
+		__dmb();
+	} while (seq != ram_seq);
+}
+
 //
 //
 //
@@ -244,10 +361,11 @@ uint16_t tbmon_idx = 0;
 volatile bool tbmon = false;
 volatile bool tbmon_loaded = false;
 
-volatile bool disabled = false;
-volatile bool read = false;
-volatile bool written = false;
-volatile bool confirmed = false;
+// set by the bus ISR for the duration of a cycle
+volatile bool bus_cycle = false;
+
+// the Z80 clock has been started, before that there is nothing to pause
+volatile bool bus_running = false;
 
 
 uint8_t bus_mask = 0;
@@ -260,9 +378,131 @@ uint16_t m_adr = 0;
 uint8_t r_op = 0;
 uint8_t w_op = 0;
 
-uint32_t d_adr = 0;
-uint32_t dr_op = 0;
-uint32_t dw_op = 0;
+// Last bus cycle as seen by the status widgets. The bus ISR publishes it on
+// core0 and the UI takes consistent copies on core1, bus_seq is odd while an
+// update is in progress.
+typedef struct {
+	uint8_t bank;
+	uint8_t low_adr;
+	uint16_t high_adr;
+	uint16_t m_adr;
+	uint8_t r_op;
+	uint8_t w_op;
+} bus_state;
+
+volatile uint32_t bus_seq = 0;
+volatile bus_state bus_last;
+
+void bus_publish(void) {
+
+	bus_seq++;
+	__dmb();
+
+	bus_last.bank = cur_bank;
+	bus_last.low_adr = low_adr;
+	bus_last.high_adr = high_adr;
+	bus_last.m_adr = m_adr;
+	bus_last.r_op = r_op;
+	bus_last.w_op = w_op;
+
+	__dmb();
+	bus_seq++;
+}
+
+//
+// Bus pause
+//
+// Most of the UI runs next to the Z80: browsing, the viewer, loading into a
+// bank the Z80 is not using. Only changing the memory or the bank it runs
+// from goes between bus_pause() and bus_resume(), which stop the Z80 clock
+// (the CPU is static, it just waits) and wait for the ISR to finish the cycle
+// it is in. Keep the window short, and do slow work (SD, prompts) outside.
+// Calls nest, UI core only.
+//
+
+static int pause_depth = 0;
+static bool clk_stopped = false;
+
+// /BUSACK comes at the end of the current machine cycle, a few clocks
+#define BUSREQ_TIMEOUT_US (1000 * 1000)
+
+static void bus_stop_clock(void) {
+
+	clk_stopped = true;
+	enable_clk(slice, false);
+
+	// an edge that came in just before the clock stopped may still be on its
+	// way into the ISR
+	sleep_us(10);
+}
+
+void bus_pause(void) {
+
+	if (pause_depth++ || !bus_running)
+		return;
+
+	gpio_put(LED_PIN, 1);
+
+#ifdef BUSREQ_OUT
+	// let the Z80 finish its machine cycle and float the bus, the clock
+	// keeps running
+	gpio_set_dir(BUSREQ_OUT, GPIO_OUT);
+
+	uint64_t start = time_us_64();
+	while (gpio_get(BUSACK_INPUT) &&
+		   time_us_64() - start < BUSREQ_TIMEOUT_US) {
+	}
+
+	// no answer (held in reset, or not fitted after all), stop the clock
+	// instead
+	if (gpio_get(BUSACK_INPUT)) {
+		gpio_set_dir(BUSREQ_OUT, GPIO_IN);
+		bus_stop_clock();
+	}
+#else
+	bus_stop_clock();
+#endif
+
+	while (bus_cycle)
+		tight_loop_contents();
+}
+
+void bus_resume(void) {
+
+	if (--pause_depth || !bus_running)
+		return;
+
+	gpio_put(LED_PIN, 0);
+
+#ifdef BUSREQ_OUT
+	gpio_set_dir(BUSREQ_OUT, GPIO_IN);
+#endif
+
+	if (clk_stopped) {
+		clk_stopped = false;
+		enable_clk(slice, true);
+	}
+}
+
+void bus_snapshot(bus_state *s) {
+
+	uint32_t seq;
+
+	do {
+		while ((seq = bus_seq) & 1)
+			tight_loop_contents();
+		__dmb();
+
+		s->bank = bus_last.bank;
+		s->low_adr = bus_last.low_adr;
+		s->high_adr = bus_last.high_adr;
+		s->m_adr = bus_last.m_adr;
+		s->r_op = bus_last.r_op;
+		s->w_op = bus_last.w_op;
+
+		__dmb();
+	} while (seq != bus_seq);
+}
 
 //
 // Utilities
@@ -302,7 +542,7 @@ void clear_bank(uint8_t bank) {
 
 void clear_screen() {
 	memset(buf, 0, SSD1306_BUF_LEN);
-	render(buf, &frame_area);
+	display_request();
 	memset(line1, 0, TEXT_BUFFER_SIZE);
 	memset(line2, 0, TEXT_BUFFER_SIZE);
 	memset(line3, 0, TEXT_BUFFER_SIZE);
@@ -338,26 +578,31 @@ void clear_line0(int line) {
 
 void clear_line(int line) {
 	clear_line0(line);
-	render(buf, &frame_area);
+	display_request();
 }
 
 void print_string0(int x, int y, char *text, ...) {
 
 	va_list args;
 	va_start(args, text);
-	vsnprintf(text_buffer, TEXT_BUFFER_SIZE, text, args);
-	strcpy(screen[y], text_buffer);
-	WriteString(buf, x * 8, y * 8, text_buffer);
+	vsnprintf(screen[y], TEXT_BUFFER_SIZE, text, args);
+	WriteString(buf, x * 8, y * 8, screen[y]);
 	va_end(args);
 }
 
 void print_string(int x, int y, char *text, ...) {
 	va_list args;
 	va_start(args, text);
-	vsnprintf(text_buffer, TEXT_BUFFER_SIZE, text, args);
-	strcpy(screen[y], text_buffer);
-	WriteString(buf, x * 8, y * 8, text_buffer);
-	render(buf, &frame_area);
+	vsnprintf(screen[y], TEXT_BUFFER_SIZE, text, args);
+	WriteString(buf, x * 8, y * 8, screen[y]);
+	va_end(args);
+	display_request();
+}
+
+// Already formatted text (see fmt.h), no printf on the way
+void print_text0(int x, int y, const char *text) {
+	fmt_str(screen[y], text);
+	WriteString(buf, x * 8, y * 8, screen[y]);
 }
 
 void print_line(int x, char *text, ...) {
@@ -372,7 +617,7 @@ void print_line(int x, char *text, ...) {
 	screen[3] = screen0;
 	strcpy(screen[3], text_buffer);
 	WriteString(buf, x * 8, 3 * 8, text_buffer);
-	render(buf, &frame_area);
+	display_request();
 	va_end(args);
 }
 
@@ -401,14 +646,14 @@ void print_char(int x, int y, char c) {
 	text_buffer[0] = c;
 	text_buffer[1] = 0;
 	WriteString(buf, x * 8, y * 8, text_buffer);
-	render(buf, &frame_area);
+	display_request();
 }
 
 void disp_plot0(int x, int y) { SetPixel(buf, x, y, true); }
 
 void disp_plot(int x, int y) {
 	SetPixel(buf, x, y, true);
-	render(buf, &frame_area);
+	display_request();
 }
 
 void disp_line0(int x1, int y1, int x2, int y2) {
@@ -417,52 +662,47 @@ void disp_line0(int x1, int y1, int x2, int y2) {
 
 void disp_line(int x1, int y1, int x2, int y2) {
 	DrawLine(buf, x1, y1, x2, y2, true);
-	render(buf, &frame_area);
+	display_request();
 }
 
-void render_display() { render(buf, &frame_area); }
+void render_display() { display_request(); }
 
+// Live view of the running bank, 4 rows of 4 bytes
 void display_ram_viewer() {
 
-	for (int line = 0; line < LINES; line++) {
+	uint8_t bytes[LINES * BYTES_PER_ROW];
+
+	ram_snapshot(cur_bank, tbmon_idx, bytes, sizeof(bytes));
 
-		// int offset = tbmon_idx + (line * BYTES_PER_ROW);
-		int offset = tbmon_idx + (line * BYTES_PER_ROW);
-		uint8_t byte_data[1];
+	for (int line = 0; line < LINES; line++) {
 
-		sprintf(tbmon_text_buffer[line], "%04x ", offset);
+		int offset = line * BYTES_PER_ROW;
+		char *p = fmt_hex(text_buffer, (tbmon_idx + offset) & (RAM_SIZE - 1), 4);
 
 		for (int col = 0; col < BYTES_PER_ROW; col++) {
+			p = fmt_str(p, col ? ":" : " ");
+			p = fmt_hex(p, bytes[offset + col], 2);
+		}
 
-			if (col < 3) {
-				sprintf(byte_data, "%02x:", sdram[offset + col]);
-			} else {
-				sprintf(byte_data, "%02x", sdram[offset + col]);
-			}
+		print_text0(0, line, text_buffer);
+	}
 
-			strcat(tbmon_text_buffer[line], byte_data);
-		}
+	display_request();
+}
 
-		strcat(tbmon_text_buffer[line], '\0');
+#define VIEWER_FAST_US (1500 * 1000)
 
-		print_string(0, line, tbmon_text_buffer[line]);
-	}
+void viewer_step(int delta) {
+	tbmon_idx = (tbmon_idx + delta) & (RAM_SIZE - 1);
+	display_ram_viewer();
 }
 
 //
 // UI Buttons
 //
 
-typedef enum { NONE, UP, DOWN, BACK, OK, CANCEL, CANCEL2 } button_state;
-
-button_state read_button_state(void) {
-
-	adc_select_input(2);
-	uint16_t adc = adc_read();
-
-	// print_string(0,3,"                   ", adc);
-
-	// print_string(8,3,"ADC:%03x           ", adc);
+// Resistor ladder level to button, the levels come from the INI
+button_state classify_adc(uint16_t adc) {
 
 	if (adc <= UP_ADC) { // UP 0x001
 		return UP;
@@ -481,15 +721,54 @@ button_state read_button_state(void) {
 	}
 }
 
+// Debounced state, sleeps until the next sample so polling loops don't spin
+button_state read_button_state(void) {
+
+	// every UI wait loop comes through here, push out pending frames
+	display_tick();
+
+	buttons_sleep();
+
+	return buttons_state();
+}
+
+button_event wait_for_event(void) {
+
+	button_event ev;
+
+	while (!buttons_get(&ev)) {
+		display_tick();
+		buttons_sleep();
+	}
+
+	return ev;
+}
+
+// true on a long press
 bool wait_for_button_release(void) {
-	uint64_t last = time_us_64();
-	while (read_button_state() != NONE) {
+
+	button_event ev;
+
+	while (true) {
+
+		// state first, a release that comes with it is already queued
+		button_state state = buttons_state();
+
+		while (buttons_get(&ev)) {
+			if (ev.type == BUTTON_RELEASE)
+				return ev.held_us >= BUTTON_LONG_US;
+		}
+
+		if (state == NONE)
+			return false;
+
+		read_button_state();
 	}
-	return (time_us_64() - last > LONG_BUTTON_DELAY);
 }
 
 void wait_for_button(void) {
-	while (read_button_state() == NONE) {
+
+	while (wait_for_event().type != BUTTON_PRESS) {
 	}
 	wait_for_button_release();
 	return;
@@ -497,19 +776,47 @@ void wait_for_button(void) {
 
 bool wait_for_yes_no_button(void) {
 
-	button_state button;
+	button_event ev;
 	while (true) {
-		button = read_button_state();
-		if (button == OK) {
+		ev = wait_for_event();
+		if (ev.type != BUTTON_PRESS)
+			continue;
+		if (ev.button == OK) {
 			wait_for_button_release();
 			return true;
-		} else if (button == CANCEL || button == CANCEL2) {
+		} else if (ev.button == CANCEL || ev.button == CANCEL2) {
 			wait_for_button_release();
 			return false;
 		}
 	}
 }
 
+// Scroll the viewer while UP/DOWN is held: one row, then one per repeat
+// event, moving a whole screen per step once held for a while
+void viewer_scroll(button_state button) {
+
+	int dir = button == UP ? -1 : 1;
+
+	viewer_step(dir * BYTES_PER_ROW);
+
+	while (true) {
+
+		button_event ev = wait_for_event();
+
+		if (ev.type == BUTTON_RELEASE)
+			return;
+
+		if (ev.button != button ||
+			(ev.type != BUTTON_LONG && ev.type != BUTTON_REPEAT))
+			continue;
+
+		if (ev.held_us > VIEWER_FAST_US)
+			viewer_step(dir * BYTES_PER_LINE);
+		else
+			viewer_step(dir * BYTES_PER_ROW);
+	}
+}
+
 //
 // UI Display Loop
 //
@@ -529,13 +836,11 @@ void display_loop() {
 
 		reset_hold();
 		clear_screen();
-		uint16_t adc = adc_read();
 
 		while (true) {
 			
-			adc_select_input(2);
-			print_string(0, 1, "ADC:%03x       ", adc_read());
-			sleep_ms(10);
+			read_button_state();
+			print_string(0, 1, "ADC:%03x       ", buttons_adc());
 		}
 	}
 
@@ -546,64 +851,106 @@ void display_loop() {
 	while (true) {
 
 		//
+		// Benchmark requested over CDC 1, SD only, the Z80 keeps running
 		//
+
+		if (bench_requested) {
+			bench_requested = false;
+			sd_test();
+			if (cur_disp_mode == ON)
+				show_info();
+			else
+				clear_screen();
+		}
+
+		if (host_cmd != HOST_NONE) {
+			host_command_run();
+			if (cur_disp_mode == ON)
+				show_info();
+		}
+
+		if (LOG_TO_FILE)
+			log_file_task();
+
+		//
+		// Status widgets, drawn from one snapshot of the bus once per frame
 		//
 
-		if (cur_disp_mode != OFF) {
+		if (display_frame_due()) {
 
-			sprintf(text_buffer, "%1x:%04x O:%02x I:%02x", cur_bank, d_adr,
-					dr_op, dw_op);
-			WriteString(buf, 0, 0, text_buffer);
+			bus_state bus;
+			bus_snapshot(&bus);
 
-			render(buf, &frame_area);
-		}
-		if ((cur_disp_mode == OFF) & (tbmon == false)) {
+			if (cur_disp_mode != OFF) {
+
+				char *p = fmt_hex(text_buffer, bus.bank, 1);
+				p = fmt_str(p, ":");
+				p = fmt_hex(p, bus.m_adr, 4);
+				p = fmt_str(p, " O:");
+				p = fmt_hex(p, bus.w_op, 2);
+				p = fmt_str(p, " I:");
+				fmt_hex(p, bus.r_op, 2);
+				WriteString(buf, 0, 0, text_buffer);
+
+				display_flush();
+			}
+			else if (tbmon == false) {
+
+				fmt_hex(fmt_str(text_buffer, "L:"), bus.low_adr, 4);
+				print_text0(0, 0, text_buffer);
+				fmt_hex(fmt_str(text_buffer, "H:"), bus.high_adr, 4);
+				print_text0(0, 1, text_buffer);
+				fmt_hex(fmt_str(text_buffer, "&:"), bus.m_adr, 4);
+				print_text0(0, 2, text_buffer);
+				fmt_hex(fmt_str(text_buffer, "R:"), bus.r_op, 2);
+				print_text0(0, 3, text_buffer);
+				fmt_hex(fmt_str(text_buffer, "W:"), bus.w_op, 2);
+				print_text0(8, 3, text_buffer);
+
+				display_flush();
+			}
+			else if (tbmon_loaded) {
 
-			print_string(0, 0, "L:%04x", low_adr);
-			print_string(0, 1, "H:%04x", high_adr);
-			print_string(0, 2, "&:%04x", m_adr);
-			print_string(0, 3, "R:%02x", r_op);
-			print_string(8, 3, "W:%02x", w_op);
+				// memory changes under the running Z80
+				display_ram_viewer();
+			}
 		}
 
 		//
 		//
 		//
 
-		buttons = read_button_state();
+		// act on presses, sleep until the next sample when there is nothing
+		button_event ev;
 
-		if (buttons != NONE) {
+		buttons = NONE;
 
-			reset_hold();
-			confirmed = false;
-			disabled = true;
+		if (buttons_get(&ev)) {
+			if (ev.type == BUTTON_PRESS)
+				buttons = ev.button;
+		} else {
+			display_tick();
+			buttons_sleep();
+		}
 
-			// in case it is in the 2nd part of the busy loop...
-			read = true;
-			written = true;
+		// scrolling the viewer only reads memory, no need to stop the bus
+		if (tbmon && tbmon_loaded && (buttons == UP || buttons == DOWN)) {
+			viewer_scroll(buttons);
+			continue;
+		}
 
-			while (!confirmed) {
-			};
+		if (buttons != NONE) {
 
-			// In your switch case:
+			// the Z80 keeps running, whatever needs the bus stopped pauses
+			// it just for that, see bus_pause()
 			switch (buttons) {
 			case UP:
 				if (!tbmon_loaded) {
 					load();
-					sleep_ms(DISPLAY_DELAY);
-					sleep_ms(DISPLAY_DELAY);
+					display_sleep_ms(DISPLAY_DELAY);
+					display_sleep_ms(DISPLAY_DELAY);
 				}
 				if (tbmon) {
-					if (tbmon_loaded) {
-						// tbmon_idx += BYTES_PER_LINE;  // Move down by one
-						// full line
-						tbmon_idx -=
-							BYTES_PER_ROW; // Move down by one full line
-						if (tbmon_idx >= RAM_SIZE - (BYTES_PER_LINE * LINES)) {
-							tbmon_idx = 0; // Wrap around if needed
-						}
-						// sleep_ms(DISPLAY_DELAY_SHORT);
-					}
 					tbmon_loaded = true;
 					display_ram_viewer();
 				} else {
@@ -617,22 +964,10 @@ void display_loop() {
 			case DOWN:
 				if (!tbmon_loaded) {
 					save();
-					sleep_ms(DISPLAY_DELAY);
-					sleep_ms(DISPLAY_DELAY);
+					display_sleep_ms(DISPLAY_DELAY);
+					display_sleep_ms(DISPLAY_DELAY);
 				}
 				if (tbmon) {
-					if (tbmon_loaded) {
-						// tbmon_idx -= BYTES_PER_LINE;  // Move up by one full
-						// line
-						tbmon_idx += BYTES_PER_ROW; // Move up by one full line
-						if (tbmon_idx < 0) {
-							tbmon_idx = RAM_SIZE -
-										(BYTES_PER_LINE * LINES); // Wrap around
-						}
-
-						// sleep_ms(DISPLAY_DELAY_SHORT);
-						// sleep_ms(DISPLAY_DELAY_SHORT);
-					}
 					tbmon_loaded = true;
 					display_ram_viewer();
 				} else {
@@ -644,16 +979,27 @@ void display_loop() {
 				break;
 
 			case BACK:
+
+				// long press runs the SD benchmark
+				if (wait_for_button_release()) {
+					sd_test();
+					if (cur_disp_mode == ON)
+						show_info();
+					else
+						clear_screen();
+					break;
+				}
+
 				// CHANGE CUR BANK
 
-				cur_bank = (cur_bank + 1) % (MAX_BANKS);
+				z80_run_bank(cur_bank + 1);
 
 				clear_screen();
 				sprintf(text_buffer, "BANK #%1x", cur_bank);
 				WriteString(buf, 0, 0, text_buffer);
-				render(buf, &frame_area);
-				sleep_ms(DISPLAY_DELAY);
-				sleep_ms(DISPLAY_DELAY);
+				display_request();
+				display_sleep_ms(DISPLAY_DELAY);
+				display_sleep_ms(DISPLAY_DELAY);
 				if (cur_disp_mode == ON)
 					show_info();
 				else
@@ -663,6 +1009,16 @@ void display_loop() {
 
 			case OK:
 
+				// long press hands the SD card to the PC
+				if (cur_disp_mode != OFF && wait_for_button_release()) {
+					usb_disk();
+					if (cur_disp_mode == ON)
+						show_info();
+					else
+						clear_screen();
+					break;
+				}
+
 				clear_screen();
 
 				if (cur_disp_mode == OFF) {
@@ -679,17 +1035,19 @@ void display_loop() {
 
 					sprintf(text_buffer, "CLEAR BANK #%1x?", cur_bank);
 					WriteString(buf, 0, 0, text_buffer);
-					render(buf, &frame_area);
+					display_request();
 					wait_for_button_release();
 
 					if (wait_for_yes_no_button()) {
+						bus_pause();
 						clear_bank(cur_bank);
+						bus_resume();
 						print_string(0, 3, "CLEARED!");
 					} else
 						print_string(0, 3, "CANCELED!");
 
-					sleep_ms(DISPLAY_DELAY);
-					sleep_ms(DISPLAY_DELAY);
+					display_sleep_ms(DISPLAY_DELAY);
+					display_sleep_ms(DISPLAY_DELAY);
 					if (cur_disp_mode == ON)
 						show_info();
 					else
@@ -709,8 +1067,8 @@ void display_loop() {
 				else
 					cur_disp_mode = OFF;
 
-				sleep_ms(DISPLAY_DELAY);
-				sleep_ms(DISPLAY_DELAY);
+				display_sleep_ms(DISPLAY_DELAY);
+				display_sleep_ms(DISPLAY_DELAY);
 
 				if (cur_disp_mode == ON)
 					show_info();
@@ -719,207 +1077,214 @@ void display_loop() {
 
 				break;
 			}
-
-			// gpio_put(LED_PIN, 0);
-			disabled = false;
-			reset_release();
 		}
 	}
 }
 
-int sd_read_init() {
+//
+// Z80NEO.INI
+//
+// machine=Z80
+// adc_cancel2=F00
+// adc_cancel=D80
+// adc_ok=C00
+// adc_back=800
+// adc_down=500
+// adc_up=200
+// bank0=COUNTER1.HEX ... bank7=COUNTER8.HEX
+// banks=8
+// clock=50
+// devices=serial,int,ctc,dma,math,crc,unpack
+// serial_rx=64
+// ctc_base=0090       first of the four CTC channels (hex)
+// ctc_clock=1000000   CTC reference clock in Hz
+// log=text            text, raw (records in PROTO_LOG frames) or off
+// log_file=0          1 keeps the records in Z80NEO.LOG on the card
+// debug_adc=0
+// verbose=0
+//
+// The old positional file (machine, the six ADC levels, four programs and
+// the debug flag, one per line) is still understood.
+//
 
-	FRESULT fr;
-	FATFS fs;
-	FIL fil;
+const char *ini_legacy_keys[] = {
+	"machine", "adc_cancel2", "adc_cancel", "adc_ok", "adc_back", "adc_down",
+	"adc_up", "bank0", "bank1", "bank2", "bank3", "debug_adc"
+};
 
-	int ret;
-	char filename[] = "Z80NEO.INI";
-	char buf[FILE_BUFF_SIZE];
-	bool skip = false;
+uint32_t ini_devices(const char *value) {
 
-	clear_screen();
+	uint32_t devices = 0;
 
-	// Initialize SD card
-	if (!spi_configured) {
-		print_string(0, 0, "INI - INIT");
-		sleep_ms(DISPLAY_DELAY_LONG);
-		skip = true;
-	}
+	while (*value) {
 
-	// Mount drive
-	if (!skip) {
+		size_t n = strcspn(value, ", ");
 
-		fr = f_mount(&fs, "", 1);
+		if (n == 6 && strncasecmp(value, "serial", 6) == 0)
+			devices |= DEVICE_SERIAL;
+		else if (n == 3 && strncasecmp(value, "int", 3) == 0)
+			devices |= DEVICE_INT;
+		else if (n == 3 && strncasecmp(value, "ctc", 3) == 0)
+			devices |= DEVICE_CTC;
+		else if (n == 3 && strncasecmp(value, "dma", 3) == 0)
+			devices |= DEVICE_DMA;
+		else if (n == 4 && strncasecmp(value, "math", 4) == 0)
+			devices |= DEVICE_MATH;
+		else if (n == 3 && strncasecmp(value, "crc", 3) == 0)
+			devices |= DEVICE_CRC;
+		else if (n == 6 && strncasecmp(value, "unpack", 6) == 0)
+			devices |= DEVICE_UNPACK;
 
-		if (FR_OK != fr) {
-			print_string(0, 0, "INI - MOUNT");
-			sleep_ms(DISPLAY_DELAY_LONG);
-			skip = true;
-		}
+		value += n;
+		value += strspn(value, ", ");
 	}
 
-	// Open file for reading
-	if (!skip) {
-		fr = f_open(&fil, filename, FA_READ);
-		if (fr != FR_OK) {
-			print_string(0, 0, "INI - OPEN");
-			skip = true;
-		}
-	}
+	return devices;
+}
+
+void ini_setting(const char *key, const char *value, int line, void *user) {
 
-	// Z80.INI:
-	// Z80))
-	// F00
-	// D80
-	// C00
-	// 800
-	// 500
-	// 200
+	int *legacy_pos = user;
 
-	// COUNTER1.HEX
-	// COUNTER2.HEX
-	// COUNTER3.HEX
-	// COUNTER4.HEX
-	// 0
+	if (!key) {
+		if (*legacy_pos >= count_of(ini_legacy_keys))
+			return;
+		key = ini_legacy_keys[(*legacy_pos)++];
+	}
 
-	while (!skip) {
+	if (ini_key_is(key, "machine")) {
+		strncpy((char *)MACHINE, value, FILE_LENGTH - 1);
+	} else if (ini_key_is(key, "adc_cancel2")) {
+		CANCEL2_ADC = strtoul(value, NULL, 16);
+	} else if (ini_key_is(key, "adc_cancel")) {
+		CANCEL_ADC = strtoul(value, NULL, 16);
+	} else if (ini_key_is(key, "adc_ok")) {
+		OK_ADC = strtoul(value, NULL, 16);
+	} else if (ini_key_is(key, "adc_back")) {
+		BACK_ADC = strtoul(value, NULL, 16);
+	} else if (ini_key_is(key, "adc_down")) {
+		DOWN_ADC = strtoul(value, NULL, 16);
+	} else if (ini_key_is(key, "adc_up")) {
+		UP_ADC = strtoul(value, NULL, 16);
+	} else if (strncasecmp(key, "bank", 4) == 0 && isdigit((unsigned char)key[4]) && !key[5]) {
+		int bank = key[4] - '0';
+		if (bank < MAX_BANKS)
+			strncpy((char *)BANK_PROG[bank], value, FILE_LENGTH - 1);
+	} else if (ini_key_is(key, "banks")) {
+		uint32_t banks = strtoul(value, NULL, 10);
+		BOOT_BANKS = banks > MAX_BANKS ? MAX_BANKS : banks;
+	} else if (ini_key_is(key, "clock")) {
+		uint32_t hz = strtoul(value, NULL, 10);
+		if (hz)
+			Z80_CLOCK = hz;
+	} else if (ini_key_is(key, "devices")) {
+		DEVICES = ini_devices(value);
+	} else if (ini_key_is(key, "serial_rx")) {
+		uint32_t size = strtoul(value, NULL, 10);
+		if (size >= 1 && size <= sizeof(serial_rx))
+			SERIAL_RX_SIZE = size;
+	} else if (ini_key_is(key, "ctc_base")) {
+		CTC_PORT = strtoul(value, NULL, 16);
+	} else if (ini_key_is(key, "ctc_clock")) {
+		uint32_t hz = strtoul(value, NULL, 10);
+		if (hz)
+			CTC_HZ = hz;
+	} else if (ini_key_is(key, "log")) {
+		if (strcasecmp(value, "raw") == 0)
+			LOG_OUTPUT = LOG_OUT_RAW;
+		else if (strcasecmp(value, "off") == 0)
+			LOG_OUTPUT = LOG_OUT_OFF;
+		else
+			LOG_OUTPUT = LOG_OUT_TEXT;
+	} else if (ini_key_is(key, "log_file")) {
+		LOG_TO_FILE = value[0] == '1';
+	} else if (ini_key_is(key, "debug_adc")) {
+		DEBUG_ADC = value[0] == '1';
+	} else if (ini_key_is(key, "verbose")) {
+		VERBOSE_INI = value[0] == '1';
+	}
+}
 
-		if (!f_gets(MACHINE, sizeof(MACHINE), &fil)) {
-			show_error(0, 0, "INI - MACHINE");
-			skip = true;
-			break;
+// The old boot output, one setting per line
+void show_ini(void) {
+
+	print_line(0, (char *)MACHINE);
+	display_sleep_ms(DISPLAY_DELAY_SHORT);
+	print_line(0, "CANCEL2: %03x     ", CANCEL2_ADC);
+	display_sleep_ms(DISPLAY_DELAY_SHORT);
+	print_line(0, "CANCEL : %03x     ", CANCEL_ADC);
+	display_sleep_ms(DISPLAY_DELAY_SHORT);
+	print_line(0, "OK     : %03x     ", OK_ADC);
+	display_sleep_ms(DISPLAY_DELAY_SHORT);
+	print_line(0, "BACK   : %03x     ", BACK_ADC);
+	display_sleep_ms(DISPLAY_DELAY_SHORT);
+	print_line(0, "DOWN   : %03x     ", DOWN_ADC);
+	display_sleep_ms(DISPLAY_DELAY_SHORT);
+	print_line(0, "UP     : %03x     ", UP_ADC);
+	display_sleep_ms(DISPLAY_DELAY_SHORT);
+
+	for (int bank = 0; bank < MAX_BANKS; bank++) {
+		if (BANK_PROG[bank][0]) {
+			print_line(0, "P%d: %12s", bank, BANK_PROG[bank]);
+			display_sleep_ms(DISPLAY_DELAY_SHORT);
 		}
-		print_line(0, MACHINE);
-		sleep_ms(DISPLAY_DELAY_SHORT);
+	}
 
-		//
-		//
-		//
+	print_line(0, "CLOCK: %lu HZ", Z80_CLOCK);
+	display_sleep_ms(DISPLAY_DELAY_SHORT);
+	print_line(0, "ADC DEBUG: %01x    ", DEBUG_ADC);
+	display_sleep_ms(DISPLAY_DELAY_SHORT);
 
-		if (!f_gets(buf, sizeof(buf), &fil)) {
-			show_error(0, 0, "INI - CANCEL2");
-			skip = true;
-			break;
-		}
-		CANCEL2_ADC = decode_hex(buf[0]) * 16 * 16 + decode_hex(buf[1]) * 16 +
-					  decode_hex(buf[2]);
-		print_line(0, "%CANCEL2: %03x     ", CANCEL2_ADC);
-		sleep_ms(DISPLAY_DELAY_SHORT);
-
-		if (!f_gets(buf, sizeof(buf), &fil)) {
-			show_error(0, 0, "INI - CANCEL");
-			skip = true;
-			break;
-		}
-		CANCEL_ADC = decode_hex(buf[0]) * 16 * 16 + decode_hex(buf[1]) * 16 +
-					 decode_hex(buf[2]);
-		print_line(0, "%CANCEL : %03x     ", CANCEL_ADC);
-		sleep_ms(DISPLAY_DELAY_SHORT);
-
-		if (!f_gets(buf, sizeof(buf), &fil)) {
-			show_error(0, 0, "INI - OK");
-			skip = true;
-			break;
-		}
-		OK_ADC = decode_hex(buf[0]) * 16 * 16 + decode_hex(buf[1]) * 16 +
-				 decode_hex(buf[2]);
-		print_line(0, "%OK     : %03x     ", OK_ADC);
-		sleep_ms(DISPLAY_DELAY_SHORT);
-
-		if (!f_gets(buf, sizeof(buf), &fil)) {
-			show_error(0, 0, "INI - BACK");
-			skip = true;
-			break;
-		}
-		BACK_ADC = decode_hex(buf[0]) * 16 * 16 + decode_hex(buf[1]) * 16 +
-				   decode_hex(buf[2]);
-		print_line(0, "%BACK   : %03x     ", BACK_ADC);
-		sleep_ms(DISPLAY_DELAY_SHORT);
-
-		if (!f_gets(buf, sizeof(buf), &fil)) {
-			show_error(0, 0, "INI - DOWN");
-			skip = true;
-			break;
-		}
-		DOWN_ADC = decode_hex(buf[0]) * 16 * 16 + decode_hex(buf[1]) * 16 +
-				   decode_hex(buf[2]);
-		print_line(0, "%DOWN   : %03x     ", DOWN_ADC);
-		sleep_ms(DISPLAY_DELAY_SHORT);
-
-		if (!f_gets(buf, sizeof(buf), &fil)) {
-			show_error(0, 0, "INI - UP");
-			skip = true;
-			break;
-		}
-		UP_ADC = decode_hex(buf[0]) * 16 * 16 + decode_hex(buf[1]) * 16 +
-				 decode_hex(buf[2]);
-		print_line(0, "%UP     : %03x     ", UP_ADC);
-		sleep_ms(DISPLAY_DELAY_SHORT);
+	clear_screen();
+}
 
-		//
-		//
-		//
+int sd_read_init() {
 
-		if (!f_gets(BANK_PROG[0], sizeof(BANK_PROG[0]), &fil)) {
-			show_error(0, 0, "INI - PROG1");
-			skip = true;
-			break;
-		}
-		print_line(0, "P1: %12s", BANK_PROG[0]);
-		sleep_ms(DISPLAY_DELAY_SHORT);
+	FRESULT fr;
+	FIL fil;
+	UINT br;
 
-		if (!f_gets(BANK_PROG[1], sizeof(BANK_PROG[1]), &fil)) {
-			show_error(0, 0, "INI - PROG2");
-			skip = true;
-			break;
-		}
-		print_line(0, "P2: %12s", BANK_PROG[1]);
-		sleep_ms(DISPLAY_DELAY_SHORT);
+	// whole file in one f_read, +1 for the parser's terminator
+	static char ini_buf[INI_MAX_SIZE + 1];
+	int legacy_pos = 0;
 
-		if (!f_gets(BANK_PROG[2], sizeof(BANK_PROG[2]), &fil)) {
-			show_error(0, 0, "INI - PROG3");
-			skip = true;
-			break;
-		}
-		print_line(0, "P3:%12s", BANK_PROG[2]);
-		sleep_ms(DISPLAY_DELAY_SHORT);
+	// Initialize SD card
+	if (!spi_configured) {
+		show_error(0, 0, "INI - INIT");
+		return -1;
+	}
 
-		if (!f_gets(BANK_PROG[3], sizeof(BANK_PROG[3]), &fil)) {
-			show_error(0, 0, "INI - PROG 4");
-			skip = true;
-			break;
-		}
-		print_line(0, "P4: %12s", BANK_PROG[3]);
-		sleep_ms(DISPLAY_DELAY_SHORT);
+	// Mount drive
+	fr = storage_mount();
+	if (FR_OK != fr) {
+		show_error(0, 0, "INI - MOUNT");
+		return -1;
+	}
 
-		break;
+	// Open file for reading
+	fr = storage_check(f_open(&fil, INI_FILE, FA_READ));
+	if (fr != FR_OK) {
+		show_error(0, 0, "INI - OPEN");
+		return -1;
 	}
 
-	//
-	//
-	//
+	fr = storage_check(f_read(&fil, ini_buf, INI_MAX_SIZE, &br));
 
-	if (!skip && f_gets(buf, sizeof(buf), &fil)) {
-		DEBUG_ADC = buf[0] == '1';
-		print_line(0, "%ADC DEBUG: 01x    ", DEBUG_ADC);
-		sleep_ms(DISPLAY_DELAY_SHORT);
+	f_close(&fil);
 
-		clear_screen();
+	if (fr != FR_OK) {
+		show_error(0, 0, "INI - READ");
+		return -1;
 	}
 
-	//
-	//
-	//
+	ini_parse(ini_buf, br, ini_setting, &legacy_pos);
 
-	// Close file
-	fr = f_close(&fil);
-	if (fr != FR_OK) {
-		show_error(0, 0, "INI - CLOSE");
+	if (VERBOSE_INI) {
+		clear_screen();
+		show_ini();
 	}
 
-	// Unmount drive
-	f_unmount("0:");
+	return 0;
 }
 
 //
@@ -927,9 +1292,6 @@ int sd_read_init() {
 //
 
 static FRESULT fr;
-static FATFS fs;
-static FIL fil;
-static char cwdbuf[FF_LFN_BUF] = {{0}};
 
 void show_error_and_halt(char *err) {
 	clear_screen();
@@ -942,7 +1304,7 @@ void show_error(int b, int a, char *err) {
 
 	clear_screen();
 	print_string(a, b, err);
-	sleep_ms(DISPLAY_DELAY_LONG);
+	display_sleep_ms(DISPLAY_DELAY_LONG);
 	return;
 }
 
@@ -952,63 +1314,46 @@ void show_error_wait_for_button(char *err) {
 	return;
 }
 
-char *init_and_mount_sd_card(void) {
+char const *init_and_mount_sd_card(void) {
 
-	char fr_buf[10];
-
-	memset(&cwdbuf, 0, FF_LFN_BUF);
+	char fr_buf[17];
 
 	if (!spi_configured) {
 
 		show_error_and_halt("SD INIT ERR1");
 	}
-	// Mount drive
-	fr = f_mount(&fs, "", 1);
+
+	// Mounted once, only pays for f_mount again after the card was removed
+	fr = storage_mount();
 
 	if (fr != FR_OK) {
 		sprintf(fr_buf, "SD INIT ERR2 %d", fr);
-		show_error_and_halt(fr_buf);
-		// show_error_and_halt("SD INIT ERR2");
-	}
-	fr = f_getcwd(cwdbuf, sizeof cwdbuf);
-	if (FR_OK != fr) {
-		show_error_and_halt("SD INIT ERR3");
+		show_error(0, 0, fr_buf);
+		return NULL;
 	}
 
-	return cwdbuf;
+	return storage_cwd();
 }
 
-int count_files() {
+// the index only serves repeat calls for a pattern it could keep
+_Static_assert(sizeof(FILE_EXT) <= DIR_PATTERN_LEN, "FILE_EXT longer than DIR_PATTERN_LEN");
 
-	int count = 0;
+int count_files() {
 
 	char const *p_dir;
 
 	p_dir = init_and_mount_sd_card();
+	if (!p_dir)
+		return 0;
 
-	DIR dj;		 /* Directory object */
-	FILINFO fno; /* File information */
-	memset(&dj, 0, sizeof dj);
-	memset(&fno, 0, sizeof fno);
+	// Scanned once per mount, later calls are served from the index
+	int count = storage_index(FILE_EXT);
 
-	fr = f_findfirst(&dj, &fno, p_dir, FILE_EXT);
-	if (FR_OK != fr) {
+	if (!storage_mounted()) {
 		show_error(0, 0, "Count Files ERR");
 		return 0;
 	}
 
-	while (fr == FR_OK && fno.fname[0]) {
-		if (fno.fattrib & AM_DIR) {
-			// directory
-		} else {
-			count++;
-		}
-
-		fr = f_findnext(&dj, &fno); /* Search for next item */
-	}
-
-	f_closedir(&dj);
-
 	return count;
 }
 
@@ -1019,43 +1364,18 @@ void clear_file_buffer() {
 }
 
 int select_file_no(int no) {
-	int count = 0;
 
 	clear_file_buffer();
 
-	char const *p_dir;
-
-	p_dir = init_and_mount_sd_card();
-
-	DIR dj;		 /* Directory object */
-	FILINFO fno; /* File information */
-	memset(&dj, 0, sizeof dj);
-	memset(&fno, 0, sizeof fno);
+	const dir_entry *entry = storage_index_entry(no);
 
-	fr = f_findfirst(&dj, &fno, p_dir, FILE_EXT);
-	if (FR_OK != fr) {
-		show_error(0, 0, "File Sel ERR");
+	if (!entry)
 		return 0;
-	}
 
-	while (fr == FR_OK && fno.fname[0]) {
-		if (fno.fattrib & AM_DIR) {
-			// directory
-		} else {
-			count++;
-			if (count == no) {
-				// copy name into file buffer for display
-				strcpy(file, fno.fname);
-				return count;
-			}
-		}
-
-		fr = f_findnext(&dj, &fno); /* Search for next item */
-	}
+	// copy name into file buffer for display
+	strcpy(file, entry->name);
 
-	f_closedir(&dj);
-
-	return 0;
+	return no;
 }
 
 int select_file() {
@@ -1154,7 +1474,7 @@ int create_name() {
 
 		switch (read_button_state()) {
 		case UP:
-			if (file[cursor] < 127) {
+			if (file[cursor] < 126) {
 				file[cursor]++;
 				wait_for_button_release();
 			}
@@ -1205,35 +1525,140 @@ int create_name() {
 // Load file
 //
 
-void load_file(bool quiet) {
+uint8_t load_buf[LOAD_CHUNK_SIZE];
+
+uint32_t load_bytes = 0;
+uint32_t load_time_us = 0;
+
+bool is_bin_file(const char *name) {
+	size_t n = strlen(name);
+	return n >= 4 && strcmp(name + n - 4, BIN_EXT) == 0;
+}
+
+// Packed files come whole into pack_buf and are unpacked into sdram. sdram
+// can't hold both: a file that barely packs is nearly as long as its output,
+// and only ZX0, with a gap the packer works out, unpacks safely over itself.
+// Straight into the bank would leave it half written on a bad file.
+static uint8_t pack_buf[RAM_SIZE];
+
+bool is_packed_file(const char *name) {
+	size_t n = strlen(name);
+	return n >= 4 && (strcmp(name + n - 4, ZX0_EXT) == 0 || strcmp(name + n - 4, LZ4_EXT) == 0);
+}
+
+// ZX0, or LZ4 as the lz4 tool writes it (a frame) or a bare block
+int packed_format(const char *name, const uint8_t *data, UINT len) {
+
+	size_t n = strlen(name);
+
+	if (strcmp(name + n - 4, ZX0_EXT) == 0)
+		return UNPACK_ZX0;
+
+	if (len >= 4 && (data[0] | data[1] << 8 | data[2] << 16 | (uint32_t)data[3] << 24) == LZ4_MAGIC)
+		return UNPACK_LZ4_FRAME;
+
+	return UNPACK_LZ4;
+}
+
+bool load_file(uint8_t bank, bool quiet) {
 
 	FRESULT fr;
-	FATFS fs;
 	FIL fil;
-	int ret;
-	char buf[FILE_BUFF_SIZE];
+	UINT br;
 	char const *p_dir;
 
+	load_bytes = 0;
+
 	if (!quiet) {
 		clear_screen();
 		print_string(0, 0, "Loading");
 		print_string(0, 1, file);
-		sleep_ms(DISPLAY_DELAY_SHORT);
+		display_sleep_ms(DISPLAY_DELAY_SHORT);
 	}
 
 	p_dir = init_and_mount_sd_card();
+	if (!p_dir)
+		return false;
 
-	fr = f_open(&fil, file, FA_READ);
+	fr = storage_check(f_open(&fil, file, FA_READ));
 
 	if (fr != FR_OK) {
-		sleep_ms(DISPLAY_DELAY_LONG);
+		display_sleep_ms(DISPLAY_DELAY_LONG);
 		show_error(0, 0, "Can't open file!");
-		sleep_ms(DISPLAY_DELAY_LONG);
+		display_sleep_ms(DISPLAY_DELAY_LONG);
 		show_error(0, 0, file);
-		sleep_ms(DISPLAY_DELAY_LONG);
-		return;
+		display_sleep_ms(DISPLAY_DELAY_LONG);
+		return false;
 	}
 
+	uint64_t load_start = time_us_64();
+
+	//
+	// Binary image, goes straight into the bank, or unpacked first
+	//
+
+	bool packed = is_packed_file(file);
+
+	if (is_bin_file(file) || packed) {
+
+		int unpacked = 0;
+
+		// staged like a HEX load, the bank only changes once the file is in
+		memset(sdram, 0, SD_RAM_SIZE);
+
+		if (!packed) {
+			fr = storage_load(&fil, sdram, RAM_SIZE, &br);
+		} else if (f_size(&fil) > sizeof(pack_buf)) {
+			fr = FR_DENIED;
+		} else {
+			fr = storage_load(&fil, pack_buf, sizeof(pack_buf), &br);
+			if (fr == FR_OK)
+				unpacked = unpack(packed_format(file, pack_buf, br), pack_buf, br, sdram, RAM_SIZE);
+		}
+
+		load_time_us = time_us_64() - load_start;
+		load_bytes = br;
+
+		f_close(&fil);
+
+		if (fr != FR_OK) {
+			show_error(0, 0, "Can't read file!");
+			return false;
+		}
+
+		if (unpacked < 0) {
+			show_error(0, 0, "Bad packed file!");
+			return false;
+		}
+
+		// the running bank is only stopped for the copy, and restarted
+		if (bank == cur_bank)
+			z80_swap_begin();
+		memcpy(ram[bank], sdram, RAM_SIZE);
+		if (bank == cur_bank)
+			z80_swap_end();
+
+		if (packed)
+			LOG(LOAD_PACKED, unpacked, bank);
+		else
+			LOG(LOAD_BIN, load_bytes, bank);
+
+		if (!quiet) {
+			clear_screen();
+			print_string(0, 0, z80_can_reset() ? "Loaded!" : "Loaded: RESET!");
+			print_string(0, 1, file);
+			display_sleep_ms(DISPLAY_DELAY);
+		}
+
+		strcpy(BANK_PROG[bank], file);
+
+		return true;
+	}
+
+	// bytes the file doesn't set come up as zero, not as leftovers of the
+	// previous load
+	memset(sdram, 0, SD_RAM_SIZE);
+
 	bool readingComment = false;
 	bool readingOrigin = false;
 
@@ -1257,20 +1682,21 @@ void load_file(bool quiet) {
 	
 	while (true) {
 
-		memset(&buf, 0, sizeof(buf));
-		if (!f_gets(buf, sizeof(buf), &fil))
+		fr = storage_check(f_read(&fil, load_buf, sizeof(load_buf), &br));
+		if (fr != FR_OK || br == 0)
 			break;
 
-		//line++;
+		load_bytes += br;
 
-		int i = 0;
-
-		while (true) {
+		for (UINT i = 0; i < br; i++) {
 
-			byte b = buf[i++];
+			byte b = load_buf[i];
 
 			if (!b)
-				break;
+				continue;
+
+			if (b == '\n')
+				line++;
 
 			if (b == '\n' || b == '\r') {
 				readingComment = false;
@@ -1294,7 +1720,7 @@ void load_file(bool quiet) {
 					show_error_wait_for_button(text_buffer);
 					clear_screen();
 					fr = f_close(&fil);
-					return;
+					return false;
 				}
 				
 				
@@ -1326,7 +1752,8 @@ void load_file(bool quiet) {
 								print_string(8, 3, text_buffer);
 							}
 							count = 0;
-							sdram[pc++] = val;
+							if (pc < SD_RAM_SIZE)
+								sdram[pc++] = val;
 							break;
 					}
 					
@@ -1389,21 +1816,25 @@ void load_file(bool quiet) {
 			    
 			}
 		}
-		line++;
+	}
+
+	load_time_us = time_us_64() - load_start;
+
+	if (fr != FR_OK) {
+		f_close(&fil);
+		show_error(0, 0, "Can't read file!");
+		return false;
 	}
 
 	//
 	//
 	//
 
-	fr = f_close(&fil);
+	fr = storage_check(f_close(&fil));
 	if (fr != FR_OK) {
 		show_error(0, 0, "Cant't close file!");
 	}
 
-	// Unmount drive
-	f_unmount("0:");
-
 	//
 	//
 	//
@@ -1412,19 +1843,26 @@ void load_file(bool quiet) {
 	if (DEBUG_LOAD){
  		sleep_ms(100);
 	}
+
+	LOG(LOAD_HEX, load_bytes, bank);
     
 	if (!quiet) {
 		clear_screen();
-		print_string(0, 0, "Loaded: RESET!");
+		print_string(0, 0, z80_can_reset() ? "Loaded!" : "Loaded: RESET!");
 		print_string(0, 1, file);
-		sleep_ms(DISPLAY_DELAY);
+		display_sleep_ms(DISPLAY_DELAY);
 	}
 
-	strcpy(BANK_PROG[cur_bank], file);
+	strcpy(BANK_PROG[bank], file);
 
 	//
+	// the running bank is only stopped for the copy, and restarted
 	//
-	//
+
+	bool active = bank == cur_bank;
+
+	if (active)
+		z80_swap_begin();
 
 	for (uint32_t b = 0; b < RAM_SIZE; b++) {
 //		uint32_t i = ((b & 0b00000000000000000000000000100000) ? 1 : 0) << 0x5 |
@@ -1438,15 +1876,18 @@ void load_file(bool quiet) {
 //					 ((b & 0b00000000000000000000000000000100) ? 1 : 0) << 0x8 |
 //					 ((b & 0b00000000000000000000000000001000) ? 1 : 0) << 0x9 |
 //					 ((b & 0b00000000000000000000000000010000) ? 1 : 0) << 0xA;
-//		ram[cur_bank][b] = sdram[i];
-		ram[cur_bank][b] = sdram[b];
+//		ram[bank][b] = sdram[i];
+		ram[bank][b] = sdram[b];
 	}
 
+	if (active)
+		z80_swap_end();
+
 	//
 	//
 	//
 
-	return;
+	return true;
 }
 
 
@@ -1461,93 +1902,39 @@ void load() {
 
 	if (aborted == -1) {
 		print_string(0, 3, "CANCELED!       ");
-		sleep_ms(DISPLAY_DELAY);
-		sleep_ms(DISPLAY_DELAY);
+		display_sleep_ms(DISPLAY_DELAY);
+		display_sleep_ms(DISPLAY_DELAY);
 		return;
 	}
 
-	load_file(true);
+	// on failure the error stays on screen
+	if (load_file(cur_bank, true)) {
+		uint32_t kbps = load_time_us ? (uint32_t)((uint64_t)load_bytes * 1000 / load_time_us) : 0;
+		print_string(0, 0, "Loaded %6lu B", load_bytes);
+		print_string(0, 1, "%6lu KB/s", kbps);
+	}
 }
 
 //
 //
 //
 
-void load_init_progs(void) {
+// Bank 0 is loaded before the Z80 clock starts, the others in the background
+// on core1 while the Z80 is already running, see core1_main()
 
-	cur_bank = 0;
-	if (BANK_PROG[0][0] >= 48) {
-		print_string(0, 3, "LOAD PROG 0");
-		sleep_ms(DISPLAY_DELAY);
-		sleep_ms(DISPLAY_DELAY);
-		strcpy(file, BANK_PROG[0]);
-		load_file(true);
-	}
-
-	cur_bank = 1;
-	if (BANK_PROG[1][0] >= 48) {
-		print_string(0, 3, "LOAD PROG 1");
-		sleep_ms(DISPLAY_DELAY);
-		sleep_ms(DISPLAY_DELAY);
-		strcpy(file, BANK_PROG[1]);
-		load_file(true);
-	}
-
-	cur_bank = 2;
-	if (BANK_PROG[2][0] >= 48) {
-		print_string(0, 3, "LOAD PROG 2");
-		sleep_ms(DISPLAY_DELAY);
-		sleep_ms(DISPLAY_DELAY);
-		strcpy(file, BANK_PROG[2]);
-		load_file(true);
-	}
-
-	cur_bank = 3;
-	if (BANK_PROG[3][0] >= 48) {
-		print_string(0, 3, "LOAD PROG 3");
-		sleep_ms(DISPLAY_DELAY);
-		sleep_ms(DISPLAY_DELAY);
-		strcpy(file, BANK_PROG[3]);
-		load_file(true);
-	}
-
-	cur_bank = 4;
-	if (BANK_PROG[4][0] >= 48) {
-		print_string(0, 3, "LOAD PROG 4");
-		sleep_ms(DISPLAY_DELAY);
-		sleep_ms(DISPLAY_DELAY);
-		strcpy(file, BANK_PROG[4]);
-		load_file(true);
-	}
-
-	cur_bank = 5;
-	if (BANK_PROG[5][0] >= 48) {
-		print_string(0, 3, "LOAD PROG 5");
-		sleep_ms(DISPLAY_DELAY);
-		sleep_ms(DISPLAY_DELAY);
-		strcpy(file, BANK_PROG[5]);
-		load_file(true);
-	}
-
-	cur_bank = 6;
-	if (BANK_PROG[6][0] >= 48) {
-		print_string(0, 3, "LOAD PROG 6");
-		sleep_ms(DISPLAY_DELAY);
-		sleep_ms(DISPLAY_DELAY);
-		strcpy(file, BANK_PROG[6]);
-		load_file(true);
-	}
-
-	cur_bank = 7;
-	if (BANK_PROG[7][0] >= 48) {
-		print_string(0, 3, "LOAD PROG 7");
-		sleep_ms(DISPLAY_DELAY);
-		sleep_ms(DISPLAY_DELAY);
-		strcpy(file, BANK_PROG[7]);
-		load_file(true);
-	}
+void load_init_progs(uint8_t first_bank, uint8_t last_bank) {
 
-	cur_bank = 0;
+	for (uint8_t bank = first_bank; bank < last_bank; bank++) {
+
+		// INI lines may still carry their line ending
+		BANK_PROG[bank][strcspn((char *)BANK_PROG[bank], "\r\n")] = 0;
+
+		if (BANK_PROG[bank][0] < 48)
+			continue;
+
+		strcpy(file, (char *)BANK_PROG[bank]);
+		load_file(bank, true);
+	}
 }
 
 //
@@ -1559,6 +1946,9 @@ void save() {
 	// 0800
 	// 000 - 7FFF
 
+	// consistent image of the running bank
+	bus_pause();
+
 	for (uint32_t b = 0; b < RAM_SIZE; b++) {
 //		uint32_t i = ((b & 0b00000000000000000000000000100000) ? 1 : 0) << 0x5 |
 //					 ((b & 0b00000000000000000000000001000000) ? 1 : 0) << 0x0 |
@@ -1575,13 +1965,15 @@ void save() {
 		sdram[b] = ram[cur_bank][b];
 	}
 
+	bus_resume();
+
 	clear_screen();
 	int aborted = create_name();
 
 	if (aborted == -1) {
 		print_string(0, 3, "CANCELED!       ");
-		sleep_ms(DISPLAY_DELAY);
-		sleep_ms(DISPLAY_DELAY);
+		display_sleep_ms(DISPLAY_DELAY);
+		display_sleep_ms(DISPLAY_DELAY);
 		return;
 	}
 
@@ -1589,21 +1981,21 @@ void save() {
 	print_string(0, 1, file);
 
 	FRESULT fr;
-	FATFS fs;
 	FIL fil;
 	int ret;
-	char buf[100];
 	char const *p_dir;
 
 	p_dir = init_and_mount_sd_card();
+	if (!p_dir)
+		return;
 
-	fr = f_open(&fil, file, FA_READ);
+	fr = storage_check(f_open(&fil, file, FA_READ));
 	if (FR_OK == fr) {
 		print_string(0, 2, "Overwrite File?");
 		if (!wait_for_yes_no_button()) {
 			print_string(0, 3, "*** CANCELED ***");
-			sleep_ms(DISPLAY_DELAY);
-			sleep_ms(DISPLAY_DELAY);
+			display_sleep_ms(DISPLAY_DELAY);
+			display_sleep_ms(DISPLAY_DELAY);
 			f_close(&fil);
 			return;
 		} else
@@ -1616,7 +2008,7 @@ void save() {
 	//
 
 	// Open file for writing ()
-	fr = f_open(&fil, file, FA_WRITE | FA_CREATE_ALWAYS);
+	fr = storage_check(f_open(&fil, file, FA_WRITE | FA_CREATE_ALWAYS));
 	if (fr != FR_OK) {
 		show_error(0, 0, "WRITE ERROR 1");
 		f_close(&fil);
@@ -1643,7 +2035,10 @@ void save() {
 	//
 	//
 
-	fr = f_close(&fil);
+	fr = storage_check(f_close(&fil));
+
+	// directory changed, rescan on the next browse
+	storage_index_invalidate();
 	
 	if (fr != FR_OK) {
 		show_error_wait_for_button("CANT'T CLOSE FILE");
@@ -1651,15 +2046,109 @@ void save() {
 	} else {
 		strcpy(BANK_PROG[cur_bank], file);
 		print_string(0, 3, "Saved: %s", file);
-		sleep_ms(DISPLAY_DELAY);
-		sleep_ms(DISPLAY_DELAY);
+		display_sleep_ms(DISPLAY_DELAY);
+		display_sleep_ms(DISPLAY_DELAY);
+	}
+
+	//
+	//
+	//
+
+	return;
+}
+
+//
+// PGM 3 - SD Card benchmark
+//
+
+void sd_test(void) {
+
+	sd_bench_result res;
+	bool report = report_len == 0; // core0 still sending the last one?
+	uint32_t len = 0;
+
+	clear_screen();
+	print_string(0, 0, "SD BENCHMARK");
+
+	if (!spi_configured) {
+		show_error_wait_for_button("SD INIT ERR1");
+		return;
+	}
+
+	for (int i = 0; i < count_of(SD_BENCH_CLOCKS); i++) {
+
+		print_string(0, 3, "RUN @ %2lu MHZ   ", SD_BENCH_CLOCKS[i] / MHZ);
+		display_flush();
+
+		sd_bench_run(&sd_config, SD_BENCH_CLOCKS[i], &res);
+
+		clear_screen();
+		print_string(0, 0, "%2luMHZ MNT:%4lu", res.clk_hz / MHZ, res.mount_us / 1000);
+		print_string(0, 1, "WR:%6lu KB/S", res.write_kbps);
+		print_string(0, 2, "RD:%6lu KB/S", res.read_kbps);
+		if (res.fr == FR_OK)
+			print_string(0, 3, "RND:%5lu IOPS", res.rand_iops);
+		else
+			print_string(0, 3, "ERROR %d", res.fr);
+
+		if (report && len < REPORT_BUFFER_SIZE) {
+			int n = sd_bench_format(&res, report_buffer + len, REPORT_BUFFER_SIZE - len);
+			if (n > 0)
+				len += n < REPORT_BUFFER_SIZE - len ? n : REPORT_BUFFER_SIZE - len - 1;
+		}
+
+		display_sleep_ms(DISPLAY_DELAY_LONG);
+	}
+
+	// back to the normal clock
+	sd_config.clk_fast = CLK_FAST_DEFAULT;
+	pico_fatfs_set_config(&sd_config);
+	storage_unmount();
+	storage_mount();
+
+	// hand the text over to core0 for CDC 1
+	if (report)
+		report_len = len;
+
+	print_string(0, 3, "DONE - PRESS KEY");
+	wait_for_button();
+}
+
+// The SD card as a USB drive until the PC ejects it or a key is pressed. The
+// Z80 keeps running, but nothing here touches the card meanwhile.
+void usb_disk(void) {
+
+	button_event ev;
+
+	clear_screen();
+	print_string(0, 0, "USB DISK");
+
+	if (!spi_configured || !storage_lend()) {
+		show_error_wait_for_button("SD INIT ERR1");
+		return;
+	}
+
+	LOG(USB_DISK, 1);
+
+	print_string(0, 2, "EJECT ON PC");
+	print_string(0, 3, "OR PRESS A KEY");
+
+	buttons_flush();
+
+	while (storage_lent()) {
+		if (buttons_get(&ev) && ev.type == BUTTON_PRESS) {
+			wait_for_button_release();
+			break;
+		}
+		read_button_state();
 	}
 
-	//
-	//
-	//
+	usb_msc_reclaim();
 
-	return;
+	LOG(USB_DISK, 0);
+
+	// fresh mount, the PC may have changed anything
+	storage_mount();
 }
 
 //
@@ -1676,20 +2165,24 @@ void show_logo(void) {
 
 	clear_screen();
 
-	print_string(0, 0, "    TurBoRAM    ");
-	print_string(0, 1, VERSION);
-	print_string(center_string(MACHINE), 2, MACHINE);
-	print_string(0, 3, " TurBoss  2025 ");
+	print_string0(0, 0, "    TurBoRAM    ");
+	print_string0(0, 1, VERSION);
+	print_string0(center_string(MACHINE), 2, MACHINE);
+	print_string0(0, 3, " TurBoss  2025 ");
+
+	display_request();
 }
 
 void show_info(void) {
 
 	clear_screen();
 
-	print_string(0, 0, "%s", BANK_PROG[cur_bank]);
-	print_string(0, 1, "BANK:%d SIZE:%04x", MAX_BANKS, RAM_SIZE);
-	print_string(0, 2, "TYPE:%s", MACHINE);
-	print_string(0, 3, "BANK:%d", cur_bank);
+	print_string0(0, 0, "%s", BANK_PROG[cur_bank]);
+	print_string0(0, 1, "BANK:%d SIZE:%04x", MAX_BANKS, RAM_SIZE);
+	print_string0(0, 2, "TYPE:%s", MACHINE);
+	print_string0(0, 3, "BANK:%d", cur_bank);
+
+	display_request();
 }
 
 //
@@ -1697,12 +2190,148 @@ void show_info(void) {
 //
 
 void reset_release(void) {
-	// gpio_set_dir(RESET_OUT, GPIO_IN);
+#ifdef RESET_OUT
+	gpio_set_dir(RESET_OUT, GPIO_IN);
+#endif
 }
 
 void reset_hold(void) {
-	//	gpio_set_dir(RESET_OUT, GPIO_OUT);
-	//	gpio_put(RESET_OUT, 0);
+#ifdef RESET_OUT
+	gpio_set_dir(RESET_OUT, GPIO_OUT);
+	gpio_put(RESET_OUT, 0);
+#endif
+}
+
+//
+// Z80 control
+//
+
+bool z80_can_reset(void) {
+#ifdef RESET_OUT
+	return true;
+#else
+	return false;
+#endif
+}
+
+// /RESET has to stay low for at least 3 clocks, 4 to be safe
+uint32_t reset_time_us(void) {
+	uint32_t us = 4 * 1000000 / (Z80_CLOCK ? Z80_CLOCK : 1);
+	return us < 10 ? 10 : us;
+}
+
+// The emulated devices go back to their reset state with every restart or
+// program change, /RESET wired or not
+void z80_reset(void) {
+	reset_hold();
+	io_reset();
+	sleep_us(reset_time_us());
+	reset_release();
+}
+
+// Around a change of the program the Z80 runs. With /RESET wired the Z80 is
+// held in reset, which also keeps it off the bus, and starts over at 0 when
+// it's done. Without it the Z80 is only paused and has to be reset by hand.
+void z80_swap_begin(void) {
+	// boot, the Z80 is still held in reset
+	if (!bus_running)
+		return;
+
+	if (z80_can_reset()) {
+		reset_hold();
+		while (bus_cycle)
+			tight_loop_contents();
+	} else
+		bus_pause();
+
+	io_reset();
+}
+
+void z80_swap_end(void) {
+	if (!bus_running)
+		return;
+
+	if (z80_can_reset()) {
+		sleep_us(reset_time_us());
+		reset_release();
+	} else
+		bus_resume();
+}
+
+void z80_run_bank(uint8_t bank) {
+	z80_swap_begin();
+	cur_bank = bank % MAX_BANKS;
+	z80_swap_end();
+}
+
+//
+// Host commands (CDC 1), parsed by core0 and run here
+//
+// RESET            restart the Z80
+// RUN <bank>       switch to a bank and restart
+// LOAD <file> [b]  load a file from SD into a bank (default the current one)
+//                  and run it
+//
+// BANK, RESET and RUN frames (proto.h) end up here too, answered by core0.
+//
+
+void host_reply(const char *fmt, ...) {
+
+	// core0 still sending the last one, the host gets nothing this time
+	if (report_len || host_quiet)
+		return;
+
+	va_list args;
+	va_start(args, fmt);
+	int n = vsnprintf(report_buffer, REPORT_BUFFER_SIZE, fmt, args);
+	va_end(args);
+
+	if (n > 0)
+		report_len = n < REPORT_BUFFER_SIZE ? n : REPORT_BUFFER_SIZE - 1;
+}
+
+void host_command_run(void) {
+
+	const char *note = z80_can_reset() ? "" : " (RESET BY HAND)";
+	uint8_t bank = host_bank % MAX_BANKS;
+
+	LOG(HOST_CMD, host_cmd, bank);
+
+	switch (host_cmd) {
+	case HOST_RESET:
+		z80_reset();
+		host_reply("OK RESET%s\r\n", note);
+		break;
+
+	case HOST_RUN:
+		z80_run_bank(bank);
+		host_reply("OK RUN %d%s\r\n", bank, note);
+		break;
+
+	case HOST_LOAD:
+		strcpy(file, host_file);
+		if (!load_file(bank, true)) {
+			host_reply("ERR LOAD %s\r\n", host_file);
+			break;
+		}
+		// the current bank restarted with the load already
+		if (bank != cur_bank)
+			z80_run_bank(bank);
+		host_reply("OK LOAD %s %d %lu%s\r\n", host_file, bank, load_bytes, note);
+		break;
+
+	case HOST_BANK:
+		// no restart, the Z80 carries on in the other bank
+		bus_pause();
+		cur_bank = bank;
+		bus_resume();
+		break;
+
+	default:
+		break;
+	}
+
+	host_cmd = HOST_NONE;
 }
 
 //
@@ -1737,6 +2366,68 @@ void nop_delay(){
 */
 
 
+//
+// Emulated devices. Their registers are decoded on the full address of the
+// cycle, in page 0 next to the serial port, and read back from the state the
+// devices keep ready so an access costs no more than a RAM one.
+//
+
+bool io_read(uint16_t adr, uint8_t *val) {
+
+	if ((DEVICES & DEVICE_INT) && z80_int_read(adr, val))
+		return true;
+	if ((DEVICES & DEVICE_CTC) && z80_ctc_read(adr, val))
+		return true;
+	if ((DEVICES & DEVICE_DMA) && z80_dma_read(adr, val))
+		return true;
+	if ((DEVICES & DEVICE_MATH) && z80_math_read(adr, val))
+		return true;
+	if ((DEVICES & DEVICE_CRC) && z80_crc_read(adr, val))
+		return true;
+	if ((DEVICES & DEVICE_UNPACK) && z80_unpack_read(adr, val))
+		return true;
+
+	return false;
+}
+
+bool io_write(uint16_t adr, uint8_t val) {
+
+	if ((DEVICES & DEVICE_INT) && z80_int_write(adr, val))
+		return true;
+	if ((DEVICES & DEVICE_CTC) && z80_ctc_write(adr, val))
+		return true;
+	if ((DEVICES & DEVICE_DMA) && z80_dma_write(adr, val))
+		return true;
+	if ((DEVICES & DEVICE_MATH) && z80_math_write(adr, val))
+		return true;
+	if ((DEVICES & DEVICE_CRC) && z80_crc_write(adr, val))
+		return true;
+	if ((DEVICES & DEVICE_UNPACK) && z80_unpack_write(adr, val))
+		return true;
+
+	return false;
+}
+
+void io_reset(void) {
+	z80_ctc_reset();
+	z80_dma_reset();
+	z80_math_reset();
+	z80_crc_reset();
+	z80_unpack_reset();
+	z80_int_reset();
+}
+
+// serial conditions the interrupt controller follows, core0
+static inline void serial_int_levels(void) {
+	z80_int_levels((serial_rx_head != serial_rx_tail ? INT_RX : 0) |
+				   (serial_tx_head == serial_tx_tail ? INT_TX : 0));
+}
+
+void int_button(button_state b) {
+	if (DEVICES & DEVICE_INT)
+		z80_int_button(b);
+}
+
 bool mreq = true;
 bool rd = true;
 
@@ -1748,9 +2439,49 @@ uint8_t r_delay = 3;
 uint8_t rd_delay = 3;
 uint8_t w_delay = 3;
 
+#ifdef M1_INPUT
+// Interrupt acknowledge, /IORQ together with /M1: the vector goes on the data
+// bus like a memory read
+void int_ack_cycle(void) {
+
+	w_op = z80_int_ack();
+
+	// DIRECTION 3 DATA
+	gpio_put(DIR1_OUT, 1);
+	gpio_put(DIR2_OUT, 1);
+	gpio_put(DIR3_OUT, 1);
+
+	// SLECT 3 DATA
+	gpio_put(SEL1_OUT, 1);
+	gpio_put(SEL2_OUT, 1);
+	gpio_put(SEL3_OUT, 0);
+
+	set_bus_dir(1);
+
+	gpio_set_dir_masked(bus_mask, bus_mask);
+	gpio_put_masked(bus_mask, (w_op << BUS_GPIO_START));
+
+	sleep_ms(w_delay);
+
+	// SELECT OFF
+	gpio_put(SEL1_OUT, 1);
+	gpio_put(SEL2_OUT, 1);
+	gpio_put(SEL3_OUT, 1);
+
+	gpio_put_masked(bus_mask, (0 << BUS_GPIO_START));
+	gpio_set_dir_masked(bus_mask, 0);
+}
+#endif
+
 void bus_callback(uint pin, uint32_t events) {
 
+	bus_cycle = true;
 
+#ifdef M1_INPUT
+	if (pin == IORQ_INPUT && !gpio_get(M1_INPUT)) {
+		int_ack_cycle();
+	} else
+#endif
 	if (pin == IORQ_INPUT) {
 
 
@@ -1820,21 +2551,25 @@ void bus_callback(uint pin, uint32_t events) {
 			r_op = (gpio_get_all() & bus_mask) >> BUS_GPIO_START ;
 
 
-			if (low_adr == SERIAL_PORT){
+			if ((DEVICES & DEVICE_SERIAL) && low_adr == SERIAL_PORT){
 				
-				// printf("%c", r_op);
-				
-				if (r_op != 0) {
-					
-					sprintf(tx_buffer, "%c", r_op);
-					
-					tud_cdc_n_write(0, tx_buffer, 1);
-			        tud_cdc_n_write_flush(0);
+				// dropped when the host doesn't keep up
+				if (r_op != 0 &&
+					(uint16_t)(serial_tx_head - serial_tx_tail) < CDC_SERIAL_TX_SIZE) {
+					serial_tx[serial_tx_head & (CDC_SERIAL_TX_SIZE - 1)] = r_op;
+					__dmb();
+					serial_tx_head++;
 				}
+
+				serial_int_levels();
 		        
 			}
-			else{
+			else if (!io_write(m_adr, r_op)) {
+				ram_seq++;
+				__dmb();
 				ram[cur_bank][m_adr] = r_op;
+				__dmb();
+				ram_seq++;
 			}
 			
 			gpio_set_dir_masked(bus_mask, 0);
@@ -1948,17 +2683,15 @@ void bus_callback(uint pin, uint32_t events) {
 				gpio_put(SEL2_OUT, 1);
 				gpio_put(SEL3_OUT, 0);
 					
-				if (m_adr == SERIAL_PORT) {
+				if ((DEVICES & DEVICE_SERIAL) && m_adr == SERIAL_PORT) {
 					
 				    // Z80 is reading from serial port
 				    
-		        	printf("DATA ON: %x \n", rx_data_available);
-		        	
 				    w_op = 0;
 				    
-				    if (rx_data_available) {
+				    if (serial_rx_head != serial_rx_tail) {
 						
-				        w_op = rx_buffer[rx_head];
+				        w_op = serial_rx[serial_rx_tail & (CDC_SERIAL_RX_SIZE - 1)];
 					
 					
 					    set_bus_dir(1);
@@ -1967,18 +2700,20 @@ void bus_callback(uint pin, uint32_t events) {
 					    gpio_put_masked(bus_mask, (w_op << BUS_GPIO_START));
 					    
 					    
-				        rx_head++;
+				        __dmb();
+				        serial_rx_tail++;
 				        
-				        if (rx_head >= CFG_TUD_CDC_RX_BUFSIZE) rx_head = 0;
-				        if (rx_head == rx_tail) rx_data_available = false;
+				        LOG(SERIAL_IN, w_op, (uint16_t)(serial_rx_head - serial_rx_tail));
 				        
+				        serial_int_levels();
 				    }
 				    
 				}
 				else{
 				
-					
-					w_op = ram[cur_bank][m_adr];
+					// device registers, RAM otherwise
+					if (!io_read(m_adr, &w_op))
+						w_op = ram[cur_bank][m_adr];
 					
 			
 					set_bus_dir(1);
@@ -2008,6 +2743,10 @@ void bus_callback(uint pin, uint32_t events) {
 			}
 		}
 	}
+
+	bus_publish();
+
+	bus_cycle = false;
 }
 
 //
@@ -2015,62 +2754,477 @@ void bus_callback(uint pin, uint32_t events) {
 //
 
 
-void custom_cdc_task(void)
-{
-    // polling CDC interfaces if wanted
+//
+// CDC 1, text commands and binary frames (proto.h)
+//
+
+static proto_parser host_parser;
+static proto_line host_line;
+
+// one reply at a time, the host waits for it before it sends the next frame
+static uint8_t host_tx[PROTO_MAX_PAYLOAD + PROTO_OVERHEAD];
+static uint32_t host_tx_len = 0;
+static uint32_t host_tx_pos = 0;
+
+// BANK, RESET or RUN handed to core1, answered when host_cmd is back to NONE
+static bool host_waiting = false;
+static uint8_t host_wait_cmd;
+static uint8_t host_wait_seq;
+
+static uint8_t host_data[PROTO_MAX_DATA];
+
+// reports queued by core1 (SD benchmark results, host_reply())
+static uint32_t report_pos = 0;
+
+bool host_command_parse(char *cmd);
+
+static void host_send(uint8_t cmd, uint8_t seq, uint8_t status,
+                      const uint8_t *data, uint16_t len) {
+    host_tx_len = proto_encode(host_tx, sizeof(host_tx), cmd | PROTO_REPLY, seq,
+                               status, data, len);
+    host_tx_pos = 0;
+}
+
+// a text command's own reply, it goes out as CDC1_FRAME like a reply frame
+static void host_say(const char *text) {
+    host_tx_len = strlen(text);
+    memcpy(host_tx, text, host_tx_len);
+    host_tx_pos = 0;
+}
+
+// The bus ISR runs on this core, with interrupts off it can't see half a copy.
+// ram_seq still brackets it for core1's ram_snapshot().
+static void host_ram_write(uint8_t bank, uint16_t adr, const uint8_t *src,
+                           uint16_t len) {
+    uint32_t irq = save_and_disable_interrupts();
+    ram_seq++;
+    __dmb();
+    memcpy(&ram[bank][adr], src, len);
+    __dmb();
+    ram_seq++;
+    restore_interrupts(irq);
+}
+
+static void host_frame(const proto_frame *f) {
+
+    const uint8_t *p = f->payload;
+    uint8_t status = PROTO_OK;
+    uint16_t len = 0;
+    uint16_t adr, n;
+
+    switch (f->cmd) {
+    case PROTO_PING:
+        host_data[0] = PROTO_VERSION;
+        host_data[1] = MAX_BANKS;
+        host_data[2] = RAM_SIZE & 0xFF;
+        host_data[3] = RAM_SIZE >> 8;
+        host_data[4] = PROTO_MAX_DATA & 0xFF;
+        host_data[5] = PROTO_MAX_DATA >> 8;
+        host_data[6] = z80_can_reset() ? PROTO_CAN_RESET : 0;
+        len = 7;
+        break;
+
+    case PROTO_WRITE:
+        if (f->len < 3) {
+            status = PROTO_ERR_LEN;
+            break;
+        }
+        adr = p[1] | p[2] << 8;
+        n = f->len - 3;
+        if (p[0] >= MAX_BANKS || adr + n > RAM_SIZE) {
+            status = PROTO_ERR_ARG;
+            break;
+        }
+        host_ram_write(p[0], adr, p + 3, n);
+        break;
+
+    case PROTO_READ:
+        if (f->len != 5) {
+            status = PROTO_ERR_LEN;
+            break;
+        }
+        adr = p[1] | p[2] << 8;
+        n = p[3] | p[4] << 8;
+        if (p[0] >= MAX_BANKS || n > PROTO_MAX_DATA || adr + n > RAM_SIZE) {
+            status = PROTO_ERR_ARG;
+            break;
+        }
+        ram_snapshot(p[0], adr, host_data, n);
+        len = n;
+        break;
+
+    case PROTO_BANK:
+    case PROTO_RUN:
+    case PROTO_RESET:
+        if (f->len != (f->cmd == PROTO_RESET ? 0 : 1)) {
+            status = PROTO_ERR_LEN;
+            break;
+        }
+        if (f->len && p[0] >= MAX_BANKS) {
+            status = PROTO_ERR_ARG;
+            break;
+        }
+        if (host_cmd != HOST_NONE) {
+            status = PROTO_ERR_BUSY;
+            break;
+        }
+        host_quiet = true;
+        host_bank = f->len ? p[0] : 0;
+        host_cmd = f->cmd == PROTO_BANK  ? HOST_BANK
+                   : f->cmd == PROTO_RUN ? HOST_RUN
+                                         : HOST_RESET;
+        host_waiting = true;
+        host_wait_cmd = f->cmd;
+        host_wait_seq = f->seq;
+        return;
+
+    default:
+        status = PROTO_ERR_CMD;
+        break;
+    }
+
+    host_send(f->cmd, f->seq, status, host_data, status == PROTO_OK ? len : 0);
+}
+
+// A byte at a time up to the line end, so a frame sent right behind the
+// command stays in the FIFO. A line split over USB packets is put back
+// together in host_line.
+static void host_text(void) {
+
+    uint8_t c;
+
+    while (tud_cdc_n_peek(1, &c)) {
+
+        size_t used;
+        int r = proto_line_feed(&host_line, &c, 1, &used);
+
+        if (used)
+            tud_cdc_n_read(1, &c, 1);
+
+        if (r < 0) {
+            LOG(HOST_TEXT, PROTO_LINE_MAX + 1);
+            return;
+        }
+
+        if (r > 0)
+            break;
+
+        if (!used)
+            return;
+    }
 
-    // Check if CDC interface 0 (for pico sdk stdio) is connected and ready
+    if (!host_line.done)
+        return;
 
-    if (tud_cdc_n_connected(0)) {
-        // print on CDC 0 some debug message
-        // printf("Connected to CDC 0\n");
-        // sleep_ms(5000); // wait for 5 seconds
+    if (strncmp(host_line.text, "BENCH", 5) == 0) {
+        bench_requested = true;
+        return;
+    }
+
+    if (host_command_parse(host_line.text))
+        return;
+
+    LOG(HOST_TEXT, host_line.len);
+}
+
+// Read CDC 1 here rather than in tud_cdc_rx_cb(), only as much as can be
+// handled, the rest stays in the FIFO and holds the host off
+static void host_rx_task(void) {
+
+    static uint8_t chunk[CDC_HOST_RX_SIZE];
+
+    if (host_waiting && host_cmd == HOST_NONE) {
+        host_waiting = false;
+        host_send(host_wait_cmd, host_wait_seq, PROTO_OK, NULL, 0);
+    }
+
+    while (!host_tx_len && !host_waiting && tud_cdc_n_available(1)) {
+
+        uint8_t c;
+
+        // frames start with SOF, anything else between them is a text command
+        if (proto_idle(&host_parser) && tud_cdc_n_peek(1, &c) &&
+            (c != PROTO_SOF || (host_line.len && !host_line.done))) {
+            host_text();
+            continue;
+        }
+
+        uint32_t n = proto_wanted(&host_parser);
+        if (n > sizeof(chunk))
+            n = sizeof(chunk);
+
+        n = tud_cdc_n_read(1, chunk, n);
+
+        // never more than the frame needs, so nothing is left over
+        int r = proto_feed(&host_parser, chunk, n, NULL);
+
+        if (r > 0)
+            host_frame(&host_parser.frame);
+        else if (r < 0)
+            host_send(host_parser.frame.cmd, host_parser.frame.seq, -r, NULL, 0);
+    }
+}
+
+// CDC 1 carries reply frames, reports and the log. Whoever starts sending
+// keeps the interface until it's done, so nothing lands inside anything else.
+typedef enum { CDC1_IDLE, CDC1_FRAME, CDC1_REPORT, CDC1_LOG } cdc1_sender;
+
+static cdc1_sender cdc1_owner = CDC1_IDLE;
+
+// a line of text, or a PROTO_LOG frame of raw records
+#define LOG_FRAME_RECORDS 16
+
+static log_record log_data[LOG_FRAME_RECORDS];
+static uint8_t log_tx[LOG_FRAME_RECORDS * sizeof(log_record) + PROTO_OVERHEAD + 1];
+static uint32_t log_len = 0;
+static uint32_t log_pos = 0;
+static uint8_t log_seq = 0;
+
+// next record out of the rings, the SD file gets a copy
+static bool log_next(log_record *r) {
+
+    if (!log_get(r))
+        return false;
+
+    if (LOG_TO_FILE)
+        log_file_put(r);
+
+    return true;
+}
+
+static bool log_fill(void) {
+
+    if (LOG_OUTPUT == LOG_OUT_RAW) {
+        int n = 0;
+
+        while (n < LOG_FRAME_RECORDS && log_next(&log_data[n]))
+            n++;
+        if (!n)
+            return false;
+
+        log_len = proto_encode(log_tx, sizeof(log_tx), PROTO_LOG, log_seq++, PROTO_OK,
+                               (const uint8_t *)log_data, n * sizeof(log_record));
+    } else {
+        if (!log_next(&log_data[0]))
+            return false;
+
+        log_len = log_format(&log_data[0], (char *)log_tx, LOG_LINE_SIZE);
+    }
+
+    log_pos = 0;
+
+    return true;
+}
+
+// Records nobody on CDC 1 takes: the file still gets them, otherwise they wait
+// for the host, or go when the log is off
+static void log_idle_task(bool connected) {
+
+    log_record r;
+
+    if (LOG_OUTPUT != LOG_OUT_OFF && (connected || !LOG_TO_FILE))
+        return;
+
+    while (log_next(&r)) {
+    }
+}
+
+// as much as fits in the FIFO, returns the new position
+static uint32_t cdc1_write(const void *data, uint32_t pos, uint32_t len) {
+
+    uint32_t n = len - pos;
+    uint32_t avail = tud_cdc_n_write_available(1);
+
+    if (n > avail)
+        n = avail;
+
+    pos += tud_cdc_n_write(1, (const uint8_t *)data + pos, n);
+    tud_cdc_n_write_flush(1);
+
+    return pos;
+}
+
+static void cdc1_tx_task(void) {
+
+    if (cdc1_owner == CDC1_IDLE) {
+        if (host_tx_len)
+            cdc1_owner = CDC1_FRAME;
+        else if (report_len)
+            cdc1_owner = CDC1_REPORT;
+        else if (LOG_OUTPUT != LOG_OUT_OFF && log_fill())
+            cdc1_owner = CDC1_LOG;
+        else
+            return;
+    }
+
+    switch (cdc1_owner) {
+    case CDC1_FRAME:
+        host_tx_pos = cdc1_write(host_tx, host_tx_pos, host_tx_len);
+        if (host_tx_pos >= host_tx_len) {
+            host_tx_pos = 0;
+            host_tx_len = 0;
+            cdc1_owner = CDC1_IDLE;
+        }
+        break;
+
+    case CDC1_REPORT:
+        report_pos = cdc1_write(report_buffer, report_pos, report_len);
+        if (report_pos >= report_len) {
+            report_pos = 0;
+            report_len = 0;
+            cdc1_owner = CDC1_IDLE;
+        }
+        break;
+
+    case CDC1_LOG:
+        log_pos = cdc1_write(log_tx, log_pos, log_len);
+        if (log_pos >= log_len)
+            cdc1_owner = CDC1_IDLE;
+        break;
+
+    default:
+        break;
     }
 }
 
+static void serial_task(void) {
+
+    // Z80 to host, in runs up to the end of the ring
+    uint16_t n = serial_tx_head - serial_tx_tail;
+
+    if (n) {
+        while (n) {
+            uint16_t pos = serial_tx_tail & (CDC_SERIAL_TX_SIZE - 1);
+            uint32_t run = CDC_SERIAL_TX_SIZE - pos;
+            if (run > n)
+                run = n;
+
+            run = tud_cdc_n_write(0, serial_tx + pos, run);
+            if (!run)
+                break;
+
+            __dmb();
+            serial_tx_tail += run;
+            n -= run;
+        }
+        tud_cdc_n_write_flush(0);
+    }
+
+    // host to Z80, no more than SERIAL_RX_SIZE ahead of it
+    uint16_t used = serial_rx_head - serial_rx_tail;
 
+    while (used < SERIAL_RX_SIZE && tud_cdc_n_available(0)) {
+        uint16_t pos = serial_rx_head & (CDC_SERIAL_RX_SIZE - 1);
+        uint32_t run = CDC_SERIAL_RX_SIZE - pos;
+        if (run > SERIAL_RX_SIZE - used)
+            run = SERIAL_RX_SIZE - used;
 
-// callback when data is received on a CDC interface
-void tud_cdc_rx_cb(uint8_t itf)
+        run = tud_cdc_n_read(0, serial_rx + pos, run);
+        if (!run)
+            break;
+
+        __dmb();
+        serial_rx_head += run;
+        used += run;
+    }
+
+    serial_int_levels();
+}
+
+void custom_cdc_task(void)
 {
-	
-    // allocate buffer for the data in the stack
-    
+    // CDC 0 is the Z80 serial port and nothing else
+    serial_task();
+
+    log_idle_task(tud_cdc_n_connected(1));
+
+    if (!tud_cdc_n_connected(1)) {
+        report_pos = 0;
+        report_len = 0;
+        host_tx_pos = 0;
+        host_tx_len = 0;
+        host_waiting = false;
+        proto_reset(&host_parser);
+        proto_line_reset(&host_line);
+        // the log waits for the host, a line cut short is lost
+        cdc1_owner = CDC1_IDLE;
+        return;
+    }
 
+    // CDC 1 is commands in, replies and log out
+    host_rx_task();
+    cdc1_tx_task();
+}
 
-    // printf("RX CDC %d\n", itf);
-	
-	// read the available data 
-    // | IMPORTANT: also do this for CDC0 because otherwise
-    // | you won't be able to print anymore to CDC0
-    // | next time this function is called
-    uint32_t count = tud_cdc_n_read(itf, rx_buffer, sizeof(rx_buffer));
+// cmd starts with word and nothing runs on, returns its argument or NULL
+static char *host_word(char *cmd, const char *word) {
 
-    // check if the data was received on the second cdc interface
-    
-    if (itf == 1) {
-        // process the received data
-        rx_buffer[count] = 0; // null-terminate the string
-        
-        // now echo data back to the console on CDC 0
-        printf("RX1: %s\n", rx_buffer);
-
-        // and echo back OK on CDC 1
-        // tud_cdc_n_write(itf, (uint8_t const *) "OK\r\n", 4);
-        // tud_cdc_n_write_flush(itf);
+    size_t n = strlen(word);
+
+    if (strncmp(cmd, word, n) != 0 || (cmd[n] && cmd[n] != ' '))
+        return NULL;
+
+    cmd += n;
+    while (*cmd == ' ')
+        cmd++;
+
+    return cmd;
+}
+
+// RESET, RUN <bank>, LOAD <file> [bank], handed to core1, NMI right here
+bool host_command_parse(char *cmd) {
+
+    char *arg;
+
+    cmd[strcspn(cmd, "\r\n")] = 0;
+
+    if (host_word(cmd, "NMI")) {
+        z80_int_nmi(reset_time_us());
+        host_say("OK\r\n");
+        return true;
     }
-    
-    else {
-        rx_buffer[count] = 0;
-        
-        for (int i = 0; i < count; i++) {
-			printf("%c", rx_buffer[i]);
-		}
 
-        rx_data_available = true;
-	}
+    if (!host_word(cmd, "RESET") && !host_word(cmd, "RUN") && !host_word(cmd, "LOAD"))
+        return false;
+
+    if (host_cmd != HOST_NONE) {
+        host_say("BUSY\r\n");
+        return true;
+    }
+
+    host_quiet = false;
+
+    if (host_word(cmd, "RESET")) {
+        host_cmd = HOST_RESET;
+    } else if ((arg = host_word(cmd, "RUN"))) {
+        if (!isdigit((unsigned char)*arg)) {
+            host_say("ERR BANK\r\n");
+            return true;
+        }
+        host_bank = atoi(arg);
+        host_cmd = HOST_RUN;
+    } else {
+        arg = host_word(cmd, "LOAD");
+
+        size_t n = strcspn(arg, " ");
+        if (!n || n >= FILE_LENGTH) {
+            host_say("ERR NAME\r\n");
+            return true;
+        }
+
+        memcpy(host_file, arg, n);
+        host_file[n] = 0;
+        host_bank = arg[n] ? atoi(arg + n) : cur_bank;
+        host_cmd = HOST_LOAD;
+    }
+
+    return true;
 }
 
+// Both interfaces are polled from custom_cdc_task() and read only as fast as
+// they are consumed, whatever is left in the FIFO holds the host off. No
+// tud_cdc_rx_cb().
+
 
 
 
@@ -2090,22 +3244,30 @@ uint pwm_set_freq_duty(uint gpio, uint32_t freq, float duty_cycle) {
 	// Find out which PWM slice is connected to GPIO 0 (it's slice 0)
 	uint slice_num = pwm_gpio_to_slice_num(gpio);
 
-	// Set the PWM frequency to 50 Hz
-	// The system clock is typically 125 MHz, so we need to divide it down
-	// 125,000,000 Hz / 50 Hz = 2,500,000
-	// We need to set the wrap value to 2,500,000 / 4096 (max duty cycle
-	// resolution)
-	// uint32_t clock_div = 2500000 / 4096; // 50hz
-	
-	uint32_t clock_div = (clock_get_hz(clk_sys)/50) / 4096;
-	
+	// Aim for a period of 4096 cycles (12-bit resolution). The divider is
+	// 8.4 fixed point and tops out below 256, so slow clocks (50 Hz from a
+	// 150 MHz system clock would need ~732) keep the divider at its maximum
+	// and stretch the wrap instead.
+	uint32_t sys_hz = clock_get_hz(clk_sys);
+	float clock_div = (float)sys_hz / freq / 4096;
+	uint32_t wrap = 4095;
+
+	if (clock_div > 255.0f) {
+		clock_div = 255.0f;
+		wrap = sys_hz / 255 / freq - 1;
+		if (wrap > 0xFFFF)
+			wrap = 0xFFFF;
+	} else if (clock_div < 1.0f) {
+		clock_div = 1.0f;
+		wrap = sys_hz / freq - 1;
+	}
+
 	pwm_set_clkdiv(slice_num, clock_div);
 
-	// Set period of 4096 cycles (for 12-bit resolution)
-	pwm_set_wrap(slice_num, 4095);
+	pwm_set_wrap(slice_num, wrap);
 
 	// Set the duty cycle
-	pwm_set_chan_level(slice_num, PWM_CHAN_A, 2049); // between 0 and 4096
+	pwm_set_chan_level(slice_num, PWM_CHAN_A, (uint16_t)((wrap + 1) * duty_cycle / 100.0f));
 
 	// ============================================================
 	return slice_num;
@@ -2121,7 +3283,28 @@ void enable_clk(uint slice_num, bool enable){
 
 
 
-static uint8_t display_buf[SSD1306_BUF_LEN];
+// Minimum time the splash stays up, it no longer holds back the Z80
+#define SPLASH_TIME_US (1000 * 1000)
+
+uint64_t boot_start = 0;
+
+void core1_main(void) {
+
+	// button sampling moves to a timer on this core
+	buttons_start();
+	buttons_on_press(int_button);
+
+	// SD is ours from here on, core0 is busy with the bus
+	load_init_progs(1, BOOT_BANKS);
+
+	uint64_t shown = time_us_64() - boot_start;
+	if (shown < SPLASH_TIME_US)
+		sleep_us(SPLASH_TIME_US - shown);
+
+	show_info();
+
+	display_loop();
+}
 
 bool previous_ce = false;
 bool previous_we = false;
@@ -2138,6 +3321,9 @@ int main() {
 	//
 	//
 	
+	// first, anything may log from here on
+	log_init();
+	LOG(BOOT);
 	
 	// USB
     board_init();
@@ -2148,28 +3334,11 @@ int main() {
         board_init_after_tusb();
     }
     
-	stdio_init_all();
-
-	sleep_ms(100);
-
 
-	slice = pwm_set_freq_duty(GPIO_PWM_SIG, 50, 50.0f);
 	
 
 
-	pico_fatfs_spi_config_t fs_config = {
-		spi0, // if unmatched SPI pin assignments with spi0/spi1 or explicitly
-			  // designated as NULL, SPI PIO will be configured
-		CLK_SLOW_DEFAULT, CLK_FAST_DEFAULT,
-		PIN_SPI1_MISO,	 // SPIx_RX
-		PIN_SPI1_SCK,	 // SPIx_CS
-		PIN_SPI1_CS,	 // SPIx_SCK
-		PIN_SPI1_MOSI,	 // SPIx_TX
-		true // use internal pullup
-	};
-
-
-	spi_configured = pico_fatfs_set_config(&fs_config);
+	spi_configured = pico_fatfs_set_config(&sd_config);
 
 
 	gpio_init(LED_PIN);
@@ -2179,10 +3348,30 @@ int main() {
 	//
 	//
 
-	//	gpio_init(RESET_OUT);
-	//	gpio_set_function(RESET_OUT, GPIO_FUNC_SIO);
-	//
-	//	reset_hold();
+	// the Z80 stays in reset until its clock has been running for a while,
+	// see below
+#ifdef RESET_OUT
+	gpio_init(RESET_OUT);
+	gpio_set_function(RESET_OUT, GPIO_FUNC_SIO);
+
+	reset_hold();
+#endif
+
+#ifdef BUSREQ_OUT
+	gpio_init(BUSREQ_OUT);
+	gpio_put(BUSREQ_OUT, 0);
+	gpio_set_dir(BUSREQ_OUT, GPIO_IN);
+
+	gpio_init(BUSACK_INPUT);
+	gpio_set_dir(BUSACK_INPUT, GPIO_IN);
+#endif
+
+	z80_int_init(INT_OUT, NMI_OUT);
+
+#ifdef M1_INPUT
+	gpio_init(M1_INPUT);
+	gpio_set_dir(M1_INPUT, GPIO_IN);
+#endif
 
 	//
 	//
@@ -2190,6 +3379,7 @@ int main() {
 
 	adc_init();
 	adc_gpio_init(ADC_KEYS_INPUT);
+	buttons_init(ADC_KEYS_CHANNEL, classify_adc);
 
 	//
 	//
@@ -2200,15 +3390,9 @@ int main() {
 	calc_render_area_buflen(&frame_area);
 	
 	// zero the entire display
-	memset(display_buf, 0, SSD1306_BUF_LEN);
-	render(display_buf, &frame_area);
-
-
-	show_logo();
-
+	buf = display_init();
+	display_flush();
 
-	sleep_ms(DISPLAY_DELAY_LONG);
-	sleep_ms(DISPLAY_DELAY_LONG);
 
 	//
 	//
@@ -2221,35 +3405,26 @@ int main() {
 	}
 
 	//
+	// Boot: INI, then bank 0 only, the rest loads on core1 behind the splash
 	//
-	//
-
-	// sd_test();
 
-	clear_screen();
-	WriteString(buf, 0, 0, "SD READ");
-	render(buf, &frame_area);
-	sleep_ms(DISPLAY_DELAY_SHORT);
+	boot_start = time_us_64();
 
 	sd_read_init();
 
-	/*
-	clear_screen();
-	WriteString(buf, 0, 0, "LOAD PROGS");
-	render(buf, &frame_area);
-	sleep_ms(DISPLAY_DELAY_SHORT);
-
-
-	load_init_progs();
-	*/
+	// devices placed by the INI
+	z80_ctc_init(CTC_PORT, CTC_HZ);
+	z80_dma_init(&ram[0][0], RAM_SIZE, MAX_BANKS, &cur_bank, &ram_seq);
+	z80_crc_init(&ram[0][0], RAM_SIZE, MAX_BANKS, &cur_bank);
+	z80_unpack_init(&ram[0][0], RAM_SIZE, MAX_BANKS, &cur_bank, &ram_seq);
 
-	clear_screen();
+	// Z80 clock comes from the INI, it only starts running further down
+	slice = pwm_set_freq_duty(GPIO_PWM_SIG, Z80_CLOCK, 50.0f);
 
-	WriteString(buf, 0, 0, "SHOW INFO");
-	render(buf, &frame_area);
-	sleep_ms(DISPLAY_DELAY_SHORT);
+	show_logo();
+	display_flush();
 
-	show_info();
+	load_init_progs(0, 1);
 
 
 
@@ -2350,7 +3525,7 @@ int main() {
 	w_op = 0;
 
 
-	multicore_launch_core1(display_loop);
+	multicore_launch_core1(core1_main);
 
 
 	while (DEBUG_ADC) {
@@ -2363,18 +3538,12 @@ int main() {
 	//
 
 
-	read = false;
-	written = false;
-	confirmed = false;
-
 	gpio_set_dir_masked(bus_mask, 0);
 
 	gpio_put(SEL1_OUT, 1);
 	gpio_put(SEL2_OUT, 1);
 	gpio_put(SEL3_OUT, 1);
 
-	reset_release();
-
 	// gpio_set_irq_enabled_with_callback(21, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, true, &gpio_callback);
 	
 	gpio_set_irq_enabled_with_callback(MREQ_INPUT, GPIO_IRQ_EDGE_FALL, true, &bus_callback);
@@ -2386,18 +3555,18 @@ int main() {
 
 
 	// Enable CPU clock	
+	bus_running = true;
 	enable_clk(slice, true);
+
+	// clocks for the reset the Z80 was held in since boot
+	if (z80_can_reset()) {
+		sleep_us(reset_time_us());
+		reset_release();
+	}
 	
 	
 	while (true) {
 
-		if (disabled) {
-			gpio_put(LED_PIN, 1);
-			confirmed = true;
-			while (disabled) {
-			};
-		}
-		
 		tud_task();
 		
 		// custom tasks
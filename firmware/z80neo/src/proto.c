@@ -0,0 +1,201 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "proto.h"
+
+enum { S_SOF, S_CMD, S_SEQ, S_LEN0, S_LEN1, S_PAYLOAD, S_CRC0, S_CRC1 };
+
+uint16_t proto_crc16(uint16_t crc, const uint8_t *data, size_t len) {
+
+	while (len--) {
+		crc ^= (uint16_t)*data++ << 8;
+		for (int i = 0; i < 8; i++)
+			crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+	}
+
+	return crc;
+}
+
+void proto_reset(proto_parser *p) {
+	p->state = S_SOF;
+	p->got = 0;
+}
+
+int proto_idle(const proto_parser *p) { return p->state == S_SOF; }
+
+// Bytes still missing from the current frame, so the caller can read exactly
+// that much and never past the end of it
+size_t proto_wanted(const proto_parser *p) {
+
+	switch (p->state) {
+	case S_SOF:
+		return PROTO_OVERHEAD;
+	case S_CMD:
+		return PROTO_OVERHEAD - 1;
+	case S_SEQ:
+		return PROTO_OVERHEAD - 2;
+	case S_LEN0:
+		return PROTO_OVERHEAD - 3;
+	case S_LEN1:
+		return PROTO_OVERHEAD - 4;
+	case S_PAYLOAD:
+		return p->frame.len - p->got + 2;
+	case S_CRC0:
+		return 2;
+	default:
+		return 1;
+	}
+}
+
+// Feed received bytes. Stops after a complete frame, *used tells how many
+// bytes were taken. Returns 1 for a good frame, 0 while more bytes are needed
+// and -PROTO_ERR_CRC or -PROTO_ERR_LEN for a bad one (frame.cmd and frame.seq
+// are valid for the error reply).
+int proto_feed(proto_parser *p, const uint8_t *data, size_t len, size_t *used) {
+
+	size_t i = 0;
+	int ret = 0;
+
+	while (i < len && !ret) {
+
+		uint8_t b = data[i++];
+
+		switch (p->state) {
+		case S_SOF:
+			// anything between frames is ignored
+			if (b == PROTO_SOF)
+				p->state = S_CMD;
+			break;
+		case S_CMD:
+			p->frame.cmd = b;
+			p->state = S_SEQ;
+			break;
+		case S_SEQ:
+			p->frame.seq = b;
+			p->state = S_LEN0;
+			break;
+		case S_LEN0:
+			p->frame.len = b;
+			p->state = S_LEN1;
+			break;
+		case S_LEN1:
+			p->frame.len |= (uint16_t)b << 8;
+			p->got = 0;
+			if (p->frame.len > PROTO_MAX_PAYLOAD) {
+				proto_reset(p);
+				ret = -PROTO_ERR_LEN;
+			} else
+				p->state = p->frame.len ? S_PAYLOAD : S_CRC0;
+			break;
+		case S_PAYLOAD: {
+			// take the whole run at once
+			size_t n = p->frame.len - p->got;
+			if (n > len - i + 1)
+				n = len - i + 1;
+			memcpy(p->frame.payload + p->got, data + i - 1, n);
+			p->got += n;
+			i += n - 1;
+			if (p->got == p->frame.len)
+				p->state = S_CRC0;
+			break;
+		}
+		case S_CRC0:
+			p->crc = b;
+			p->state = S_CRC1;
+			break;
+		case S_CRC1: {
+			uint8_t hdr[4] = {p->frame.cmd, p->frame.seq, p->frame.len & 0xFF,
+							  p->frame.len >> 8};
+			uint16_t crc = proto_crc16(0xFFFF, hdr, sizeof(hdr));
+			crc = proto_crc16(crc, p->frame.payload, p->frame.len);
+			p->crc |= (uint16_t)b << 8;
+			proto_reset(p);
+			ret = crc == p->crc ? 1 : -PROTO_ERR_CRC;
+			break;
+		}
+		}
+	}
+
+	if (used)
+		*used = i;
+
+	return ret;
+}
+
+void proto_line_reset(proto_line *l) {
+	l->len = 0;
+	l->done = 0;
+	l->overflow = 0;
+	l->text[0] = 0;
+}
+
+// Collects a text command across reads. Stops after the line end, or before
+// a SOF (not taken, the frame parser gets it), *used tells how many bytes
+// were taken. Returns 1 with the line in text, 0 while more bytes are needed
+// and -PROTO_ERR_LEN for a line over PROTO_LINE_MAX, which is dropped. Empty
+// lines, like the '\n' of a "\r\n", are skipped.
+int proto_line_feed(proto_line *l, const uint8_t *data, size_t len, size_t *used) {
+
+	size_t i = 0;
+	int ret = 0;
+
+	if (l->done)
+		proto_line_reset(l);
+
+	while (i < len && !ret) {
+
+		uint8_t b = data[i];
+
+		if (b == PROTO_SOF) {
+			if (l->len || l->overflow)
+				ret = l->overflow ? -PROTO_ERR_LEN : 1;
+			break;
+		}
+
+		i++;
+
+		if (b == '\r' || b == '\n') {
+			if (l->len || l->overflow)
+				ret = l->overflow ? -PROTO_ERR_LEN : 1;
+		} else if (l->len < PROTO_LINE_MAX)
+			l->text[l->len++] = b;
+		else
+			l->overflow = 1;
+	}
+
+	l->text[l->len] = 0;
+
+	if (ret)
+		l->done = 1;
+
+	if (used)
+		*used = i;
+
+	return ret;
+}
+
+// Reply frame with status + data, returns its size or 0 if out is too small
+size_t proto_encode(uint8_t *out, size_t size, uint8_t cmd, uint8_t seq,
+					uint8_t status, const uint8_t *data, uint16_t len) {
+
+	uint16_t plen = len + 1;
+
+	if (size < (size_t)plen + PROTO_OVERHEAD)
+		return 0;
+
+	out[0] = PROTO_SOF;
+	out[1] = cmd;
+	out[2] = seq;
+	out[3] = plen & 0xFF;
+	out[4] = plen >> 8;
+	out[5] = status;
+	if (len)
+		memcpy(out + 6, data, len);
+
+	uint16_t crc = proto_crc16(0xFFFF, out + 1, 4 + plen);
+	out[5 + plen] = crc & 0xFF;
+	out[6 + plen] = crc >> 8;
+
+	return plen + PROTO_OVERHEAD;
+}
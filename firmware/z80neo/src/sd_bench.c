@@ -0,0 +1,270 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pico/stdlib.h>
+#include <pico/time.h>
+
+#include "ff.h"
+#include "tf_card.h"
+
+#include "sd_bench.h"
+#include "storage.h"
+
+// Set PRE_ALLOCATE true to pre-allocate file clusters.
+const bool PRE_ALLOCATE = true;
+
+// Set SKIP_FIRST_LATENCY true if the first read/write to the SD can
+// be avoid by writing a file header or reading the first record.
+const bool SKIP_FIRST_LATENCY = true;
+
+// Size of read/write.
+#define BUF_SIZE 512
+
+// File size in MB where MB = 1,000,000 bytes.
+const uint32_t FILE_SIZE_MB = 5;
+
+// Write pass count.
+const uint8_t WRITE_COUNT = 2;
+
+// Read pass count.
+const uint8_t READ_COUNT = 2;
+
+// Random single sector reads per run.
+const uint32_t RANDOM_READ_COUNT = 500;
+
+//==============================================================================
+// End of configuration constants.
+//------------------------------------------------------------------------------
+// File size in bytes.
+const uint32_t FILE_SIZE = 1000000UL * FILE_SIZE_MB;
+
+// Insure 4-byte alignment.
+static uint32_t bench_buf32[(BUF_SIZE + 3) / 4];
+
+//
+// Passes
+//
+
+static FRESULT write_pass(FIL *fil, sd_bench_result *res, uint64_t *us) {
+
+	FRESULT fr;
+	UINT bw;
+	uint8_t *bench_buf = (uint8_t *)bench_buf32;
+	uint32_t n = FILE_SIZE / BUF_SIZE;
+
+	fr = f_lseek(fil, 0);
+	if (fr != FR_OK)
+		return fr;
+
+	uint64_t start = time_us_64();
+
+	for (uint32_t i = 0; i < n; i++) {
+
+		// tag every record so a bad read back is easy to spot
+		bench_buf32[0] = i;
+
+		uint32_t t = time_us_32();
+		fr = f_write(fil, bench_buf, BUF_SIZE, &bw);
+		t = time_us_32() - t;
+
+		if (fr != FR_OK)
+			return fr;
+		if (bw != BUF_SIZE)
+			return FR_DENIED;
+
+		if (SKIP_FIRST_LATENCY && i == 0)
+			continue;
+		if (t > res->write_max_us)
+			res->write_max_us = t;
+		if (t < res->write_min_us)
+			res->write_min_us = t;
+	}
+
+	fr = f_sync(fil);
+
+	*us += time_us_64() - start;
+
+	return fr;
+}
+
+static FRESULT read_pass(FIL *fil, sd_bench_result *res, uint64_t *us) {
+
+	FRESULT fr;
+	UINT br;
+	uint8_t *bench_buf = (uint8_t *)bench_buf32;
+	uint32_t n = FILE_SIZE / BUF_SIZE;
+
+	fr = f_lseek(fil, 0);
+	if (fr != FR_OK)
+		return fr;
+
+	uint64_t start = time_us_64();
+
+	for (uint32_t i = 0; i < n; i++) {
+
+		uint32_t t = time_us_32();
+		fr = f_read(fil, bench_buf, BUF_SIZE, &br);
+		t = time_us_32() - t;
+
+		if (fr != FR_OK)
+			return fr;
+		if (br != BUF_SIZE || bench_buf32[0] != i)
+			return FR_INT_ERR;
+
+		if (SKIP_FIRST_LATENCY && i == 0)
+			continue;
+		if (t > res->read_max_us)
+			res->read_max_us = t;
+		if (t < res->read_min_us)
+			res->read_min_us = t;
+	}
+
+	*us += time_us_64() - start;
+
+	return FR_OK;
+}
+
+static FRESULT random_pass(FIL *fil, sd_bench_result *res) {
+
+	FRESULT fr;
+	UINT br;
+	uint8_t *bench_buf = (uint8_t *)bench_buf32;
+	uint32_t n = FILE_SIZE / BUF_SIZE;
+	uint32_t seed = time_us_32() | 1;
+
+	uint64_t start = time_us_64();
+
+	for (uint32_t i = 0; i < RANDOM_READ_COUNT; i++) {
+
+		// xorshift32, good enough to defeat any read ahead on the card
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+
+		uint32_t rec = seed % n;
+
+		fr = f_lseek(fil, (FSIZE_t)rec * BUF_SIZE);
+		if (fr != FR_OK)
+			return fr;
+
+		fr = f_read(fil, bench_buf, BUF_SIZE, &br);
+		if (fr != FR_OK)
+			return fr;
+		if (br != BUF_SIZE || bench_buf32[0] != rec)
+			return FR_INT_ERR;
+	}
+
+	uint64_t us = time_us_64() - start;
+
+	res->rand_avg_us = (uint32_t)(us / RANDOM_READ_COUNT);
+	res->rand_iops = us ? (uint32_t)((uint64_t)RANDOM_READ_COUNT * 1000000 / us) : 0;
+
+	return FR_OK;
+}
+
+//
+// Run
+//
+
+FRESULT sd_bench_run(pico_fatfs_spi_config_t *config, uint32_t clk_fast,
+					 sd_bench_result *res) {
+
+	FRESULT fr;
+	FIL fil;
+	uint64_t us;
+
+	memset(res, 0, sizeof(*res));
+	res->clk_hz = clk_fast;
+	res->write_min_us = UINT32_MAX;
+	res->read_min_us = UINT32_MAX;
+
+	for (int i = 0; i < BUF_SIZE; i++)
+		((uint8_t *)bench_buf32)[i] = 'A' + (i % 26);
+
+	//
+	// Mount at the new clock
+	//
+
+	config->clk_fast = clk_fast;
+	pico_fatfs_set_config(config);
+
+	storage_unmount();
+
+	us = time_us_64();
+	fr = storage_mount();
+	res->mount_us = (uint32_t)(time_us_64() - us);
+
+	if (fr != FR_OK)
+		return res->fr = fr;
+
+	//
+	// Test file
+	//
+
+	fr = storage_check(f_open(&fil, SD_BENCH_FILE, FA_CREATE_ALWAYS | FA_READ | FA_WRITE));
+	if (fr != FR_OK)
+		return res->fr = fr;
+
+#if FF_USE_EXPAND
+	if (PRE_ALLOCATE) {
+		fr = f_expand(&fil, FILE_SIZE, 1);
+		if (fr != FR_OK)
+			goto done;
+	}
+#endif
+
+	us = 0;
+	for (int pass = 0; pass < WRITE_COUNT; pass++) {
+		fr = write_pass(&fil, res, &us);
+		if (fr != FR_OK)
+			goto done;
+	}
+	res->write_kbps = us ? (uint32_t)((uint64_t)FILE_SIZE * WRITE_COUNT * 1000 / 1024 * 1000 / us) : 0;
+
+	us = 0;
+	for (int pass = 0; pass < READ_COUNT; pass++) {
+		fr = read_pass(&fil, res, &us);
+		if (fr != FR_OK)
+			goto done;
+	}
+	res->read_kbps = us ? (uint32_t)((uint64_t)FILE_SIZE * READ_COUNT * 1000 / 1024 * 1000 / us) : 0;
+
+	fr = random_pass(&fil, res);
+
+done:
+
+	f_close(&fil);
+	f_unlink(SD_BENCH_FILE);
+
+	// the directory changed under the browser
+	storage_index_invalidate();
+
+	if (res->write_min_us == UINT32_MAX)
+		res->write_min_us = 0;
+	if (res->read_min_us == UINT32_MAX)
+		res->read_min_us = 0;
+
+	return res->fr = storage_check(fr);
+}
+
+//
+// Report, one line of key=value pairs per clock
+//
+
+int sd_bench_format(const sd_bench_result *res, char *out, size_t len) {
+
+	return snprintf(out, len,
+					"SDBENCH clk_hz=%lu mount_us=%lu"
+					" wr_kbps=%lu wr_max_us=%lu wr_min_us=%lu"
+					" rd_kbps=%lu rd_max_us=%lu rd_min_us=%lu"
+					" rnd_iops=%lu rnd_avg_us=%lu fr=%d\r\n",
+					(unsigned long)res->clk_hz, (unsigned long)res->mount_us,
+					(unsigned long)res->write_kbps, (unsigned long)res->write_max_us,
+					(unsigned long)res->write_min_us, (unsigned long)res->read_kbps,
+					(unsigned long)res->read_max_us, (unsigned long)res->read_min_us,
+					(unsigned long)res->rand_iops, (unsigned long)res->rand_avg_us,
+					(int)res->fr);
+}
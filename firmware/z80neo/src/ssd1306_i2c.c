@@ -7,14 +7,13 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
-#include <ctype.h>
 
 #include <pico/stdlib.h>
 #include <pico/binary_info.h>
 #include <hardware/i2c.h>
+#include <hardware/dma.h>
 
 #include "raspberry26x32.h"
-#include "ssd1306_font.h"
 #include "ssd1306_i2c.h"
 
 
@@ -27,35 +26,113 @@ void calc_render_area_buflen(struct render_area *area) {
 
 #ifdef i2c_default
 
+// Everything sent to the panel goes through a stream of I2C DATA_CMD words
+// that a DMA channel feeds into the TX FIFO. Each transaction starts with its
+// control byte (0x00 for a command list, 0x40 for display RAM data) and has
+// STOP set on its last byte, the controller issues a new START by itself for
+// the next one. Two streams are used, one is being filled while the other one
+// is on the wire.
+
+static uint16_t stream[2][SSD1306_STREAM_LEN];
+static int stream_len = 0;
+static int fill = 0;
+
+static int dma_chan = -1;
+
+void SSD1306_dma_init() {
+    i2c_hw_t *hw = i2c_get_hw(i2c_default);
+
+    dma_chan = dma_claim_unused_channel(true);
+
+    dma_channel_config c = dma_channel_get_default_config(dma_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_16);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, i2c_get_dreq(i2c_default, true));
+
+    dma_channel_configure(dma_chan, &c, &hw->data_cmd, NULL, 0, false);
+
+    // the target never changes, so it is set once here instead of per write
+    hw->enable = 0;
+    hw->tar = SSD1306_I2C_ADDR;
+    hw->enable = 1;
+}
+
+bool SSD1306_busy() {
+    return dma_chan >= 0 && dma_channel_is_busy(dma_chan);
+}
+
+void SSD1306_wait() {
+    if (dma_chan >= 0)
+        dma_channel_wait_for_finish_blocking(dma_chan);
+}
+
+// Start the queued stream. Only waits when the previous one is still going.
+void SSD1306_kick() {
+    i2c_hw_t *hw = i2c_get_hw(i2c_default);
+
+    if (!stream_len)
+        return;
+
+    SSD1306_wait();
+
+    // a NACK from the panel flushes the FIFO and holds it until cleared
+    if (hw->raw_intr_stat & I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS)
+        (void)hw->clr_tx_abrt;
+
+    dma_channel_set_read_addr(dma_chan, stream[fill], false);
+    dma_channel_set_trans_count(dma_chan, stream_len, true);
+
+    fill ^= 1;
+    stream_len = 0;
+}
+
+static void queue(uint8_t control, const uint8_t *data, int len) {
+    if (len <= 0)
+        return;
+
+    if (stream_len + len + 1 > SSD1306_STREAM_LEN)
+        SSD1306_kick();
+
+    // still too long, can only be a caller bug
+    if (len + 1 > SSD1306_STREAM_LEN)
+        return;
+
+    uint16_t *p = stream[fill] + stream_len;
+
+    *p++ = control;
+    for (int i = 0; i < len; i++)
+        *p++ = data[i];
+    p[-1] |= I2C_IC_DATA_CMD_STOP_BITS;
+
+    stream_len += len + 1;
+}
+
+void SSD1306_queue_cmd_list(const uint8_t *cmds, int num) {
+    // Co = 0, D/C = 0 => all following bytes are commands
+    queue(0x00, cmds, num);
+}
+
+void SSD1306_queue_buf(const uint8_t *display_buf, int buflen) {
+    // Co = 0, D/C = 1 => all following bytes go to display RAM
+    queue(0x40, display_buf, buflen);
+}
+
 void SSD1306_send_cmd(uint8_t cmd) {
-    // I2C write process expects a control byte followed by data
-    // this "data" can be a command or data to follow up a command
-    // Co = 1, D/C = 0 => the driver expects a command
-    uint8_t display_buf[2] = {0x80, cmd};
-    i2c_write_blocking(i2c_default, SSD1306_I2C_ADDR, display_buf, 2, false);
+    SSD1306_send_cmd_list(&cmd, 1);
 }
 
 void SSD1306_send_cmd_list(uint8_t *display_buf, int num) {
-    for (int i=0;i<num;i++)
-        SSD1306_send_cmd(display_buf[i]);
+    SSD1306_queue_cmd_list(display_buf, num);
+    SSD1306_kick();
 }
 
 void SSD1306_send_buf(uint8_t display_buf[], int buflen) {
     // in horizontal addressing mode, the column address pointer auto-increments
     // and then wraps around to the next page, so we can send the entire frame
     // buffer in one gooooooo!
-
-    // copy our frame buffer into a new buffer because we need to add the control byte
-    // to the beginning
-
-    uint8_t * temp_buf = (uint8_t *) malloc(buflen + 1);
-
-    temp_buf[0] = 0x40;
-    memcpy(temp_buf+1, display_buf, buflen);
-
-    i2c_write_blocking(i2c_default, SSD1306_I2C_ADDR, temp_buf, buflen + 1, false);
-
-    free(temp_buf);
+    SSD1306_queue_buf(display_buf, buflen);
+    SSD1306_kick();
 }
 
 void SSD1306_init() {
@@ -123,7 +200,7 @@ void SSD1306_scroll(bool on) {
     SSD1306_send_cmd_list(cmds, count_of(cmds));
 }
 
-void render(uint8_t *display_buf, struct render_area *area) {
+void render_queue(uint8_t *display_buf, struct render_area *area) {
     // update a portion of the display with a render area
     uint8_t cmds[] = {
         SSD1306_SET_COL_ADDR,
@@ -133,9 +210,14 @@ void render(uint8_t *display_buf, struct render_area *area) {
         area->start_page,
         area->end_page
     };
-    
-    SSD1306_send_cmd_list(cmds, count_of(cmds));
-    SSD1306_send_buf(display_buf, area->buflen);
+
+    SSD1306_queue_cmd_list(cmds, count_of(cmds));
+    SSD1306_queue_buf(display_buf, area->buflen);
+}
+
+void render(uint8_t *display_buf, struct render_area *area) {
+    render_queue(display_buf, area);
+    SSD1306_kick();
 }
 
 void SetPixel(uint8_t *display_buf, int x,int y, bool on) {
@@ -190,67 +272,6 @@ void DrawLine(uint8_t *display_buf, int x0, int y0, int x1, int y1, bool on) {
     }
 }
 
-/* 
-int GetFontIndex(uint8_t ch) {
-    if (ch >= 'A' && ch <='Z') {
-        return  ch - 'A' + 1;
-    }
-    else if (ch >= '0' && ch <='9') {
-        return  ch - '0' + 27;
-    }
-    else return  0; // Not got that char so space.
-}
-*/ 
-
-int GetFontIndex(uint8_t ch) {
-  return ch - 32;
-  //return ch; 
-}
-
-uint8_t reversed[sizeof(font)] = {0};
-
-uint8_t reverse(uint8_t b) {
-   b = (b & 0xF0) >> 4 | (b & 0x0F) << 4;
-   b = (b & 0xCC) >> 2 | (b & 0x33) << 2;
-   b = (b & 0xAA) >> 1 | (b & 0x55) << 1;
-   return b;
-}
-void FillReversedCache() {
-    // calculate and cache a reversed version of fhe font, because I defined it upside down...doh!
-    for (int i=0;i<sizeof(font);i++)
-      //reversed[i] = reverse(font[i]);
-      reversed[i] = font[i]; 
-}
-
-void WriteChar(uint8_t *display_buf, int16_t x, int16_t y, uint8_t ch) {
-    if (reversed[0] == 0) 
-        FillReversedCache();
-
-    if (x > SSD1306_WIDTH - 8 || y > SSD1306_HEIGHT - 8)
-        return;
-
-    // For the moment, only write on Y row boundaries (every 8 vertical pixels)
-    y = y/8;
-
-    ch = toupper(ch);
-    int idx = GetFontIndex(ch);
-    int fb_idx = y * 128 + x;
-
-    for (int i=0;i<8;i++) {
-        display_buf[fb_idx++] = reversed[idx * 8 + i];
-    }
-}
-
-void WriteString(uint8_t *display_buf, int16_t x, int16_t y, char *str) {
-    // Cull out any string off the screen
-    if (x > SSD1306_WIDTH - 8 || y > SSD1306_HEIGHT - 8)
-        return;
-
-    while (*str) {
-        WriteChar(display_buf, x, y, *str++);
-        x+=8;
-    }
-}
 
 
 
@@ -261,14 +282,23 @@ void WriteString(uint8_t *display_buf, int16_t x, int16_t y, char *str) {
 
 
 int ssd1306_setup() {
-    stdio_init_all();
-
-    i2c_init(i2c_default, SSD1306_I2C_CLK * 1000);
     gpio_set_function(PICO_DEFAULT_I2C_SDA_PIN, GPIO_FUNC_I2C);
     gpio_set_function(PICO_DEFAULT_I2C_SCL_PIN, GPIO_FUNC_I2C);
     gpio_pull_up(PICO_DEFAULT_I2C_SDA_PIN);
     gpio_pull_up(PICO_DEFAULT_I2C_SCL_PIN);
 
+    // try the fast clock first, a panel that doesn't keep up won't ack
+    uint8_t nop[2] = {0x80, SSD1306_NOP};
+    uint khz = SSD1306_I2C_CLK_FAST;
+
+    i2c_init(i2c_default, khz * 1000);
+    if (i2c_write_blocking(i2c_default, SSD1306_I2C_ADDR, nop, 2, false) == PICO_ERROR_GENERIC) {
+        khz = SSD1306_I2C_CLK;
+        i2c_set_baudrate(i2c_default, khz * 1000);
+    }
+
+    SSD1306_dma_init();
+
     // run through the complete initialization process
     SSD1306_init();
  
@@ -277,7 +307,9 @@ int ssd1306_setup() {
 
 
     SSD1306_send_cmd(SSD1306_SET_ALL_ON);    // Set all pixels on
+    SSD1306_wait();
     sleep_ms(50);
     SSD1306_send_cmd(SSD1306_SET_ENTIRE_ON); // go back to following RAM for pixel state
-    
+
+    return khz;
 }
@@ -0,0 +1,55 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "ssd1306_font.h"
+#include "ssd1306_i2c.h"
+
+// Text drawing into a framebuffer, no Pico dependencies so it builds on the
+// host (test/bench_text.c)
+
+/* 
+int GetFontIndex(uint8_t ch) {
+    if (ch >= 'A' && ch <='Z') {
+        return  ch - 'A' + 1;
+    }
+    else if (ch >= '0' && ch <='9') {
+        return  ch - '0' + 27;
+    }
+    else return  0; // Not got that char so space.
+}
+*/ 
+
+int GetFontIndex(uint8_t ch) {
+  // lower case is drawn with the upper case glyphs, the font has both but the
+  // UI always showed upper case
+  if (ch >= 'a' && ch <= 'z')
+    ch -= 'a' - 'A';
+  if (ch < 32 || ch >= 32 + sizeof(font) / 8)
+    ch = ' ';
+  return ch - 32;
+}
+
+void WriteChar(uint8_t *display_buf, int16_t x, int16_t y, uint8_t ch) {
+    if (x > SSD1306_WIDTH - 8 || y > SSD1306_HEIGHT - 8)
+        return;
+
+    // For the moment, only write on Y row boundaries (every 8 vertical pixels)
+    y = y/8;
+
+    // a glyph is 8 column bytes, copied as one 64 bit word straight out of
+    // the constant font
+    uint64_t glyph;
+    memcpy(&glyph, &font[GetFontIndex(ch) * 8], sizeof(glyph));
+    memcpy(&display_buf[y * SSD1306_WIDTH + x], &glyph, sizeof(glyph));
+}
+
+void WriteString(uint8_t *display_buf, int16_t x, int16_t y, char *str) {
+    // Cull out any string off the screen
+    if (x > SSD1306_WIDTH - 8 || y > SSD1306_HEIGHT - 8)
+        return;
+
+    while (*str && x <= SSD1306_WIDTH - 8) {
+        WriteChar(display_buf, x, y, *str++);
+        x+=8;
+    }
+}
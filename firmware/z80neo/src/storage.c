@@ -0,0 +1,295 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ff.h"
+#include "diskio.h"
+
+#include "storage.h"
+
+static FATFS fs;
+static bool mounted = false;
+static volatile bool lent = false;
+static char cwdbuf[FF_LFN_BUF] = {0};
+
+static dir_entry dir_index[DIR_INDEX_MAX];
+static int dir_count = 0;
+static bool dir_valid = false;
+static char dir_pattern[DIR_PATTERN_LEN] = {0};
+
+//
+// Mount
+//
+
+FRESULT storage_mount(void) {
+
+	FRESULT fr;
+
+	if (lent)
+		return FR_NOT_READY;
+
+	// the diskio layer raises STA_NOINIT when the card has to be initialised
+	// again, that is our cheap "card was swapped" probe
+	if (mounted && !(disk_status(fs.pdrv) & STA_NOINIT))
+		return FR_OK;
+
+	storage_unmount();
+
+	fr = f_mount(&fs, "", 1);
+	if (fr != FR_OK)
+		return fr;
+
+	memset(cwdbuf, 0, sizeof(cwdbuf));
+
+	fr = f_getcwd(cwdbuf, sizeof(cwdbuf));
+	if (fr != FR_OK) {
+		f_unmount("");
+		return fr;
+	}
+
+	mounted = true;
+
+	return FR_OK;
+}
+
+void storage_unmount(void) {
+
+	if (mounted)
+		f_unmount("");
+
+	mounted = false;
+	dir_valid = false;
+}
+
+bool storage_mounted(void) { return mounted; }
+
+//
+// Host access
+//
+
+bool storage_lend(void) {
+
+	storage_unmount();
+
+	// the host gets a ready card or none, it never initialises it
+	if (disk_initialize(STORAGE_DRIVE) & STA_NOINIT)
+		return false;
+
+	lent = true;
+
+	return true;
+}
+
+void storage_reclaim(void) { lent = false; }
+
+bool storage_lent(void) { return lent; }
+
+//
+// Error tracking
+//
+
+FRESULT storage_check(FRESULT fr) {
+
+	switch (fr) {
+	case FR_DISK_ERR:
+	case FR_INT_ERR:
+	case FR_NOT_READY:
+	case FR_NO_FILESYSTEM:
+	case FR_INVALID_OBJECT:
+		// card removed or gone bad, force a remount on the next access
+		storage_unmount();
+		break;
+	default:
+		break;
+	}
+
+	return fr;
+}
+
+//
+//
+//
+
+const char *storage_cwd(void) { return cwdbuf; }
+
+//
+// Directory index
+//
+
+static int compare_entries(const void *a, const void *b) {
+	return strcmp(((const dir_entry *)a)->name, ((const dir_entry *)b)->name);
+}
+
+static FRESULT index_pattern(const char *pattern) {
+
+	FRESULT fr;
+	DIR dj;
+	FILINFO fno;
+
+	memset(&dj, 0, sizeof dj);
+	memset(&fno, 0, sizeof fno);
+
+	fr = storage_check(f_findfirst(&dj, &fno, cwdbuf, pattern));
+
+	while (fr == FR_OK && fno.fname[0] && dir_count < DIR_INDEX_MAX) {
+
+		if (!(fno.fattrib & AM_DIR)) {
+
+			dir_entry *e = &dir_index[dir_count++];
+
+			// long names don't fit the display line, fall back to the 8.3
+			// alias which opens the same file
+			if (strlen(fno.fname) < DIR_NAME_LEN)
+				strcpy(e->name, fno.fname);
+			else
+				strncpy(e->name, fno.altname, DIR_NAME_LEN - 1);
+			e->name[DIR_NAME_LEN - 1] = 0;
+
+			e->size = fno.fsize;
+		}
+
+		fr = storage_check(f_findnext(&dj, &fno));
+	}
+
+	f_closedir(&dj);
+
+	return fr;
+}
+
+// pattern may hold several FatFS patterns separated by '|', e.g. "*.HEX|*.BIN"
+int storage_index(const char *pattern) {
+
+	char one[DIR_NAME_LEN];
+	const char *p = pattern;
+
+	if (dir_valid && strcmp(dir_pattern, pattern) == 0)
+		return dir_count;
+
+	dir_count = 0;
+
+	if (!mounted)
+		return 0;
+
+	while (*p) {
+
+		size_t n = strcspn(p, "|");
+		if (n >= sizeof(one))
+			n = sizeof(one) - 1;
+
+		memcpy(one, p, n);
+		one[n] = 0;
+
+		if (index_pattern(one) != FR_OK) {
+			dir_count = 0;
+			return 0;
+		}
+
+		p += strcspn(p, "|");
+		if (*p)
+			p++;
+	}
+
+	qsort(dir_index, dir_count, sizeof(dir_entry), compare_entries);
+
+	// a list too long to keep is still indexed, just scanned again next time
+	if (strlen(pattern) < sizeof(dir_pattern))
+		strcpy(dir_pattern, pattern);
+	else
+		dir_pattern[0] = 0;
+	dir_valid = true;
+
+	return dir_count;
+}
+
+// no is 1 based, like the browser counter
+const dir_entry *storage_index_entry(int no) {
+
+	if (!dir_valid || no < 1 || no > dir_count)
+		return NULL;
+
+	return &dir_index[no - 1];
+}
+
+void storage_index_invalidate(void) { dir_valid = false; }
+
+//
+// Bulk loading
+//
+
+// Walk the cluster chain of an open file, true when every cluster follows the
+// previous one on the card. The seeks land on cluster boundaries so FatFS
+// only follows the FAT (served from the window cache) and does not read file
+// data, apart from the last sector of a file that ends mid sector.
+bool storage_contiguous(FIL *fil) {
+
+	FATFS *f = fil->obj.fs;
+	FSIZE_t size = f_size(fil);
+	FSIZE_t bcs = (FSIZE_t)f->csize * FF_MIN_SS;
+	DWORD clst = fil->obj.sclust;
+	bool contiguous = true;
+
+	if (!clst)
+		return false;
+
+	// seeking to the end of cluster k leaves fil->clust on cluster k
+	for (FSIZE_t ofs = 2 * bcs; ofs < size + bcs; ofs += bcs) {
+
+		if (f_lseek(fil, ofs < size ? ofs : size) != FR_OK ||
+			fil->clust != ++clst) {
+			contiguous = false;
+			break;
+		}
+	}
+
+	f_lseek(fil, 0);
+
+	return contiguous;
+}
+
+// Read up to len bytes from the start of the file into dst.
+//
+// A contiguous file is fetched with a single disk_read() over all its whole
+// sectors, which the card driver turns into one multi block (CMD18) transfer,
+// and only the tail goes through f_read(). Fragmented files fall back to one
+// big f_read(), which still moves whole clusters straight into dst.
+FRESULT storage_load(FIL *fil, uint8_t *dst, UINT len, UINT *br) {
+
+	FRESULT fr;
+	UINT done = 0;
+	UINT tail = 0;
+
+	*br = 0;
+
+	if (f_size(fil) < len)
+		len = f_size(fil);
+
+	fr = f_lseek(fil, 0);
+	if (fr != FR_OK)
+		return storage_check(fr);
+
+	if (len >= FF_MIN_SS && storage_contiguous(fil)) {
+
+		FATFS *f = fil->obj.fs;
+		LBA_t sect = f->database + (LBA_t)f->csize * (fil->obj.sclust - 2);
+		UINT count = len / FF_MIN_SS;
+
+		if (disk_read(f->pdrv, dst, sect, count) != RES_OK)
+			return storage_check(FR_DISK_ERR);
+
+		done = count * FF_MIN_SS;
+
+		fr = f_lseek(fil, done);
+		if (fr != FR_OK)
+			return storage_check(fr);
+	}
+
+	if (done < len) {
+		fr = storage_check(f_read(fil, dst + done, len - done, &tail));
+		if (fr != FR_OK)
+			return fr;
+	}
+
+	*br = done + tail;
+
+	return FR_OK;
+}
@@ -0,0 +1,256 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "unpack.h"
+
+//
+// ZX0
+//
+
+typedef struct {
+	const uint8_t *src;
+	const uint8_t *end;
+	uint8_t bits;
+	uint8_t mask;
+	uint8_t last;	// last byte read, its low bit may be read back as a bit
+	bool backtrack;
+	bool bad;
+} zx0_in;
+
+static uint8_t zx0_byte(zx0_in *in) {
+
+	if (in->src >= in->end) {
+		in->bad = true;
+		return 0;
+	}
+
+	return in->last = *in->src++;
+}
+
+static int zx0_bit(zx0_in *in) {
+
+	if (in->backtrack) {
+		in->backtrack = false;
+		return in->last & 1;
+	}
+
+	in->mask >>= 1;
+	if (!in->mask) {
+		in->mask = 0x80;
+		in->bits = zx0_byte(in);
+	}
+
+	return (in->bits & in->mask) != 0;
+}
+
+// interlaced Elias gamma, capped well past anything a 64K stream needs
+static uint32_t zx0_gamma(zx0_in *in, int inverted) {
+
+	uint32_t value = 1;
+
+	while (!zx0_bit(in) && !in->bad) {
+		value = (value << 1) | (zx0_bit(in) ^ inverted);
+		if (value > 0x1ffff) {
+			in->bad = true;
+			break;
+		}
+	}
+
+	return value;
+}
+
+int unpack_zx0(const uint8_t *src, size_t src_len, uint8_t *dst, size_t dst_len) {
+
+	zx0_in in = {.src = src, .end = src + src_len};
+	size_t out = 0;
+	uint32_t offset = 1;
+	uint32_t len;
+
+	goto literals;
+
+	for (;;) {
+
+		// new offset, its MSB, then the low 7 bits with a length bit behind
+		offset = zx0_gamma(&in, 1);
+		if (offset == 256)
+			return in.bad ? UNPACK_ERROR : (int)out;
+		offset = offset * 128 - (zx0_byte(&in) >> 1);
+		in.backtrack = true;
+		len = zx0_gamma(&in, 0) + 1;
+
+	match:
+		if (in.bad || offset > out || len > dst_len - out)
+			return UNPACK_ERROR;
+		for (uint32_t i = 0; i < len; i++, out++)
+			dst[out] = dst[out - offset];
+
+		if (zx0_bit(&in))
+			continue;
+
+	literals:
+		len = zx0_gamma(&in, 0);
+		if (in.bad || len > dst_len - out || len > (size_t)(in.end - in.src))
+			return UNPACK_ERROR;
+		memmove(dst + out, in.src, len);
+		in.src += len;
+		out += len;
+
+		if (zx0_bit(&in))
+			continue;
+
+		// the last offset again
+		len = zx0_gamma(&in, 0);
+		goto match;
+	}
+}
+
+//
+// LZ4
+//
+
+static bool lz4_length(const uint8_t **p, const uint8_t *end, uint32_t *len) {
+
+	uint8_t b;
+
+	do {
+		if (*p >= end)
+			return false;
+		b = *(*p)++;
+		*len += b;
+	} while (b == 255);
+
+	return true;
+}
+
+int unpack_lz4(const uint8_t *src, size_t src_len, uint8_t *dst, size_t dst_len) {
+
+	const uint8_t *p = src;
+	const uint8_t *end = src + src_len;
+	size_t out = 0;
+
+	while (p < end) {
+
+		uint8_t token = *p++;
+		uint32_t len = token >> 4;
+
+		if (len == 15 && !lz4_length(&p, end, &len))
+			return UNPACK_ERROR;
+		if (len > (size_t)(end - p) || len > dst_len - out)
+			return UNPACK_ERROR;
+
+		memmove(dst + out, p, len);
+		p += len;
+		out += len;
+
+		// the last sequence has literals only
+		if (p == end)
+			break;
+
+		if (end - p < 2)
+			return UNPACK_ERROR;
+		uint32_t offset = p[0] | p[1] << 8;
+		p += 2;
+
+		len = token & 15;
+		if (len == 15 && !lz4_length(&p, end, &len))
+			return UNPACK_ERROR;
+		len += 4;
+
+		if (!offset || offset > out || len > dst_len - out)
+			return UNPACK_ERROR;
+		for (uint32_t i = 0; i < len; i++, out++)
+			dst[out] = dst[out - offset];
+	}
+
+	return out;
+}
+
+static uint32_t le32(const uint8_t *p) {
+	return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+// Blocks one after the other into dst, linked or not makes no difference
+// there. The checksums aren't checked, but a frame cut short in its content
+// checksum is still an error.
+int unpack_lz4_frame(const uint8_t *src, size_t src_len, uint8_t *dst, size_t dst_len) {
+
+	const uint8_t *p = src;
+	const uint8_t *end = src + src_len;
+	size_t out = 0;
+
+	if (src_len < 7 || le32(p) != LZ4_MAGIC)
+		return UNPACK_ERROR;
+
+	uint8_t flg = p[4];
+	p += 6; // magic, FLG, BD
+
+	if ((flg >> 6) != 1)
+		return UNPACK_ERROR;
+
+	// content size, dictionary id, HC
+	size_t skip = (flg & 0x08 ? 8 : 0) + (flg & 0x01 ? 4 : 0) + 1;
+	if ((size_t)(end - p) < skip)
+		return UNPACK_ERROR;
+	p += skip;
+
+	bool block_sum = flg & 0x10;
+	bool content_sum = flg & 0x04;
+
+	for (;;) {
+
+		if (end - p < 4)
+			return UNPACK_ERROR;
+
+		uint32_t size = le32(p);
+		p += 4;
+
+		// the end mark, and the content checksum has to be all there
+		if (!size)
+			return content_sum && end - p < 4 ? UNPACK_ERROR : (int)out;
+
+		bool stored = size & 0x80000000;
+		size &= 0x7fffffff;
+
+		if (size > (size_t)(end - p))
+			return UNPACK_ERROR;
+
+		if (stored) {
+			if (size > dst_len - out)
+				return UNPACK_ERROR;
+			memmove(dst + out, p, size);
+			out += size;
+		} else {
+			int n = unpack_lz4(p, size, dst + out, dst_len - out);
+			if (n < 0)
+				return UNPACK_ERROR;
+			out += n;
+		}
+
+		p += size;
+
+		if (block_sum) {
+			if (end - p < 4)
+				return UNPACK_ERROR;
+			p += 4;
+		}
+	}
+}
+
+//
+//
+//
+
+int unpack(int format, const uint8_t *src, size_t src_len, uint8_t *dst, size_t dst_len) {
+
+	switch (format) {
+	case UNPACK_ZX0:
+		return unpack_zx0(src, src_len, dst, dst_len);
+	case UNPACK_LZ4:
+		return unpack_lz4(src, src_len, dst, dst_len);
+	case UNPACK_LZ4_FRAME:
+		return unpack_lz4_frame(src, src_len, dst, dst_len);
+	default:
+		return UNPACK_ERROR;
+	}
+}
@@ -12,7 +12,7 @@
 #define _PID_MAP(itf, n)  ( (CFG_TUD_##itf) << (n) )
 #define CDC_EXAMPLE_VID     0xCAFE
 // use _PID_MAP to generate unique PID for each interface
-#define CDC_EXAMPLE_PID     (0x4000 | _PID_MAP(CDC, 0))
+#define CDC_EXAMPLE_PID     (0x4000 | _PID_MAP(CDC, 0) | _PID_MAP(MSC, 3))
 // set USB 2.0
 #define CDC_EXAMPLE_BCD     0x0200
 
@@ -47,11 +47,12 @@ enum {
     ITF_NUM_CDC_0_DATA,
     ITF_NUM_CDC_1,
     ITF_NUM_CDC_1_DATA,
+    ITF_NUM_MSC,
     ITF_NUM_TOTAL
 };
 
 // total length of configuration descriptor
-#define CONFIG_TOTAL_LEN    (TUD_CONFIG_DESC_LEN + CFG_TUD_CDC * TUD_CDC_DESC_LEN)
+#define CONFIG_TOTAL_LEN    (TUD_CONFIG_DESC_LEN + CFG_TUD_CDC * TUD_CDC_DESC_LEN + CFG_TUD_MSC * TUD_MSC_DESC_LEN)
 
 // define endpoint numbers
 #define EPNUM_CDC_0_NOTIF   0x81 // notification endpoint for CDC 0
@@ -62,20 +63,26 @@ enum {
 #define EPNUM_CDC_1_OUT     0x05 // out endpoint for CDC 1
 #define EPNUM_CDC_1_IN      0x85 // in endpoint for CDC 1
 
-// configure descriptor (for 2 CDC interfaces)
+#define EPNUM_MSC_OUT       0x06 // out endpoint for the SD card
+#define EPNUM_MSC_IN        0x86 // in endpoint for the SD card
+
+// configure descriptor (for 2 CDC interfaces and the SD card)
 uint8_t const desc_configuration[] = {
     // config descriptor | how much power in mA, count of interfaces, ...
     TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_TOTAL, 0, CONFIG_TOTAL_LEN, 0x80, 100),
 
-    // CDC 0: Communication Interface - TODO: get 64 from tusb_config.h
-    TUD_CDC_DESCRIPTOR(ITF_NUM_CDC_0, 4, EPNUM_CDC_0_NOTIF, 8, EPNUM_CDC_0_OUT, EPNUM_CDC_0_IN, 64),
+    // CDC 0: Communication Interface
+    TUD_CDC_DESCRIPTOR(ITF_NUM_CDC_0, 4, EPNUM_CDC_0_NOTIF, 8, EPNUM_CDC_0_OUT, EPNUM_CDC_0_IN, BULK_EP_PACKET_SIZE),
     // CDC 0: Data Interface
     //TUD_CDC_DESCRIPTOR(ITF_NUM_CDC_0_DATA, 4, 0x01, 0x02),
 
-    // CDC 1: Communication Interface - TODO: get 64 from tusb_config.h
-    TUD_CDC_DESCRIPTOR(ITF_NUM_CDC_1, 4, EPNUM_CDC_1_NOTIF, 8, EPNUM_CDC_1_OUT, EPNUM_CDC_1_IN, 64),
+    // CDC 1: Communication Interface
+    TUD_CDC_DESCRIPTOR(ITF_NUM_CDC_1, 4, EPNUM_CDC_1_NOTIF, 8, EPNUM_CDC_1_OUT, EPNUM_CDC_1_IN, BULK_EP_PACKET_SIZE),
     // CDC 1: Data Interface
     //TUD_CDC_DESCRIPTOR(ITF_NUM_CDC_1_DATA, 4, 0x03, 0x04),
+
+    // SD card
+    TUD_MSC_DESCRIPTOR(ITF_NUM_MSC, 7, EPNUM_MSC_OUT, EPNUM_MSC_IN, BULK_EP_PACKET_SIZE),
 };
 
 // called when host requests to get configuration descriptor
@@ -108,6 +115,8 @@ enum {
     STRID_SERIAL,       // 3: Serials
     STRID_CDC_0,        // 4: CDC Interface 0
     STRID_CDC_1,        // 5: CDC Interface 1
+    STRID_RESET,        // 6: Reset Interface
+    STRID_MSC,          // 7: SD card
 };
 
 // array of pointer to string descriptors
@@ -117,9 +126,10 @@ char const *string_desc_arr[] = {
     "JauriaStudios",                // 1: Manufacturer
     "z80neo",                       // 2: Product
     NULL,                           // 3: Serials (null so it uses unique ID if available)
-    "Serial 1"                      // 4: CDC Interface 0
+    "Serial 1",                     // 4: CDC Interface 0
     "Serial 2",                     // 5: CDC Interface 1,
-    "Reset"                         // 6: Reset Interface
+    "Reset",                        // 6: Reset Interface
+    "SD Card"                       // 7: SD card
 };
 
 // buffer to hold the string descriptor during the request | plus 1 for the null terminator
@@ -0,0 +1,222 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <hardware/sync.h>
+#include <pico/stdlib.h>
+#include <tusb.h>
+
+#include "ff.h"
+#include "diskio.h"
+
+#include "storage.h"
+#include "usb_msc.h"
+
+// The callbacks run in tud_task() on core0, next to the bus ISR. Everything
+// else on the card belongs to core1, storage_lent() tells whose turn it is.
+
+#define SECTOR_SIZE FF_MIN_SS
+
+// Hosts go back to the FAT and directory sectors all the time, one sector at
+// a time. Those are kept here, longer transfers go straight to the card as
+// multi block reads and writes (CFG_TUD_MSC_EP_BUFSIZE bytes each).
+#define CACHE_SECTORS 8
+
+static uint8_t cache[CACHE_SECTORS][SECTOR_SIZE];
+static LBA_t cache_lba[CACHE_SECTORS];
+static bool cache_valid[CACHE_SECTORS];
+
+// set while a callback is on the card, see usb_msc_reclaim()
+static volatile bool busy = false;
+
+//
+// Arbitration
+//
+
+static bool card_take(void) {
+
+	busy = true;
+	__dmb();
+
+	if (!storage_lent()) {
+		busy = false;
+		tud_msc_set_sense(0, SCSI_SENSE_NOT_READY, 0x3A, 0x00);
+		return false;
+	}
+
+	return true;
+}
+
+static void card_give(void) {
+	__dmb();
+	busy = false;
+}
+
+// core1. Once the card is taken back no callback touches the cache, and
+// FatFS may write to the card before the next loan.
+void usb_msc_reclaim(void) {
+
+	storage_reclaim();
+	__dmb();
+
+	while (busy)
+		tight_loop_contents();
+
+	memset(cache_valid, 0, sizeof(cache_valid));
+}
+
+static void eject(void) {
+	memset(cache_valid, 0, sizeof(cache_valid));
+	storage_reclaim();
+}
+
+//
+// Cache
+//
+
+static void cache_invalidate(LBA_t lba, UINT count) {
+
+	for (int i = 0; i < CACHE_SECTORS; i++) {
+		if (cache_valid[i] && cache_lba[i] >= lba && cache_lba[i] < lba + count)
+			cache_valid[i] = false;
+	}
+}
+
+static DRESULT sector_read(uint8_t *dst, LBA_t lba, UINT count) {
+
+	if (count > 1)
+		return disk_read(STORAGE_DRIVE, dst, lba, count);
+
+	int i = lba % CACHE_SECTORS;
+
+	if (!cache_valid[i] || cache_lba[i] != lba) {
+
+		if (disk_read(STORAGE_DRIVE, cache[i], lba, 1) != RES_OK) {
+			cache_valid[i] = false;
+			return RES_ERROR;
+		}
+
+		cache_lba[i] = lba;
+		cache_valid[i] = true;
+	}
+
+	memcpy(dst, cache[i], SECTOR_SIZE);
+
+	return RES_OK;
+}
+
+//
+// TinyUSB MSC callbacks
+//
+
+void tud_msc_inquiry_cb(uint8_t lun, uint8_t vendor_id[8],
+						uint8_t product_id[16], uint8_t product_rev[4]) {
+	(void)lun;
+
+	memcpy(vendor_id, "z80neo  ", 8);
+	memcpy(product_id, "SD Card         ", 16);
+	memcpy(product_rev, "1.0 ", 4);
+}
+
+bool tud_msc_test_unit_ready_cb(uint8_t lun) {
+	(void)lun;
+
+	if (!storage_lent()) {
+		// medium not present
+		tud_msc_set_sense(lun, SCSI_SENSE_NOT_READY, 0x3A, 0x00);
+		return false;
+	}
+
+	return true;
+}
+
+void tud_msc_capacity_cb(uint8_t lun, uint32_t *block_count,
+						 uint16_t *block_size) {
+	(void)lun;
+
+	LBA_t count = 0;
+
+	if (card_take()) {
+		if (disk_ioctl(STORAGE_DRIVE, GET_SECTOR_COUNT, &count) != RES_OK)
+			count = 0;
+		card_give();
+	}
+
+	*block_count = (uint32_t)count;
+	*block_size = SECTOR_SIZE;
+}
+
+bool tud_msc_start_stop_cb(uint8_t lun, uint8_t power_condition, bool start,
+						   bool load_eject) {
+	(void)lun;
+	(void)power_condition;
+
+	// the host is done with it, back to the firmware
+	if (load_eject && !start)
+		eject();
+
+	return true;
+}
+
+bool tud_msc_is_writable_cb(uint8_t lun) {
+	(void)lun;
+	return true;
+}
+
+// TinyUSB hands over whole sectors, the endpoint buffer is a multiple of them
+int32_t tud_msc_read10_cb(uint8_t lun, uint32_t lba, uint32_t offset,
+						  void *buffer, uint32_t bufsize) {
+	(void)lun;
+
+	if (offset || bufsize % SECTOR_SIZE || !card_take())
+		return -1;
+
+	DRESULT res = sector_read(buffer, lba, bufsize / SECTOR_SIZE);
+
+	card_give();
+
+	return res == RES_OK ? (int32_t)bufsize : -1;
+}
+
+int32_t tud_msc_write10_cb(uint8_t lun, uint32_t lba, uint32_t offset,
+						   uint8_t *buffer, uint32_t bufsize) {
+	(void)lun;
+
+	if (offset || bufsize % SECTOR_SIZE || !card_take())
+		return -1;
+
+	UINT count = bufsize / SECTOR_SIZE;
+
+	cache_invalidate(lba, count);
+	DRESULT res = disk_write(STORAGE_DRIVE, buffer, lba, count);
+
+	card_give();
+
+	return res == RES_OK ? (int32_t)bufsize : -1;
+}
+
+void tud_msc_write10_complete_cb(uint8_t lun) {
+	(void)lun;
+
+	// flush the card's own write buffer once the host's command is done
+	if (card_take()) {
+		disk_ioctl(STORAGE_DRIVE, CTRL_SYNC, NULL);
+		card_give();
+	}
+}
+
+int32_t tud_msc_scsi_cb(uint8_t lun, uint8_t const scsi_cmd[16], void *buffer,
+						uint16_t bufsize) {
+	(void)buffer;
+	(void)bufsize;
+
+	switch (scsi_cmd[0]) {
+	case SCSI_CMD_PREVENT_ALLOW_MEDIUM_REMOVAL:
+		// the card can always go, the host is told to eject first
+		return 0;
+
+	default:
+		tud_msc_set_sense(lun, SCSI_SENSE_ILLEGAL_REQUEST, 0x20, 0x00);
+		return -1;
+	}
+}
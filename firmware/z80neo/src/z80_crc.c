@@ -0,0 +1,231 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <hardware/dma.h>
+#include <pico/stdlib.h>
+
+#include "z80_crc.h"
+
+static const uint8_t *ram = NULL;
+static uint32_t size = 0;
+static uint8_t nbanks = 0;
+static const uint8_t *run_bank = NULL;
+
+static int dma_chan = -1;
+
+static uint8_t regs[CRC_REGS];
+static uint8_t algo = CRC_16;
+static uint8_t status = 0;
+static uint32_t value = 0xffff; // what the Z80 reads
+
+static uint16_t crc16_table[256];
+static uint32_t crc32_table[256];
+
+#define REG16(r) (regs[r] | (regs[(r) + 1] << 8))
+
+#define RESULT 7
+
+//
+// Software, for the data port
+//
+
+static void tables(void) {
+
+	for (uint32_t i = 0; i < 256; i++) {
+
+		uint16_t c16 = i << 8;
+		uint32_t c32 = i;
+
+		for (int b = 0; b < 8; b++) {
+			c16 = c16 & 0x8000 ? (c16 << 1) ^ 0x1021 : c16 << 1;
+			c32 = c32 & 1 ? (c32 >> 1) ^ 0xedb88320 : c32 >> 1;
+		}
+
+		crc16_table[i] = c16;
+		crc32_table[i] = c32;
+	}
+}
+
+static void feed(uint8_t b) {
+
+	switch (algo) {
+	case CRC_16:
+		value = ((value << 8) ^ crc16_table[((value >> 8) ^ b) & 0xff]) & 0xffff;
+		break;
+	case CRC_32: {
+		uint32_t crc = ~value;
+		crc = (crc >> 8) ^ crc32_table[(crc ^ b) & 0xff];
+		value = ~crc;
+		break;
+	}
+	default: {
+		uint32_t s1 = (value & 0xff) + b;
+		s1 = s1 >= 255 ? s1 - 255 : s1;
+		uint32_t s2 = (value >> 8 & 0xff) + s1;
+		s2 = s2 >= 255 ? s2 - 255 : s2;
+		value = s2 << 8 | s1;
+		break;
+	}
+	}
+}
+
+//
+// Blocks, the CRCs go through the DMA sniffer
+//
+
+static uint32_t bitrev32(uint32_t v) {
+
+	uint32_t r = 0;
+
+	for (int i = 0; i < 32; i++, v >>= 1)
+		r = (r << 1) | (v & 1);
+
+	return r;
+}
+
+static void sniff(const uint8_t *src, uint32_t len) {
+
+	static uint8_t sink;
+
+	dma_channel_config c = dma_channel_get_default_config(dma_chan);
+	channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+	channel_config_set_read_increment(&c, true);
+	channel_config_set_write_increment(&c, false);
+	channel_config_set_sniff_enable(&c, true);
+
+	// CRC-32 is the reflected one: bit reversed data, and the register reads
+	// back reversed, so the seed goes in reversed too
+	if (algo == CRC_32) {
+		dma_sniffer_enable(dma_chan, DMA_SNIFF_CTRL_CALC_VALUE_CRC32R, true);
+		dma_sniffer_set_output_reverse_enabled(true);
+		dma_sniffer_set_data_accumulator(bitrev32(~value));
+	} else {
+		dma_sniffer_enable(dma_chan, DMA_SNIFF_CTRL_CALC_VALUE_CRC16, true);
+		dma_sniffer_set_output_reverse_enabled(false);
+		dma_sniffer_set_data_accumulator(value & 0xffff);
+	}
+
+	dma_channel_configure(dma_chan, &c, &sink, src, len, true);
+	dma_channel_wait_for_finish_blocking(dma_chan);
+
+	uint32_t acc = dma_sniffer_get_data_accumulator();
+	dma_sniffer_disable();
+
+	value = algo == CRC_32 ? ~acc : acc & 0xffff;
+}
+
+static void block(const uint8_t *mem, uint32_t adr, uint32_t len) {
+
+	if (algo == CRC_FLETCHER || dma_chan < 0) {
+		for (uint32_t i = 0; i < len; i++)
+			feed(mem[adr + i]);
+	} else if (len) {
+		sniff(mem + adr, len);
+	}
+}
+
+static void command(uint8_t cmd) {
+
+	algo = cmd & CRC_ALGO;
+	if (algo > CRC_FLETCHER)
+		algo = CRC_FLETCHER;
+
+	if (cmd & CRC_RESTART)
+		value = algo == CRC_16 ? 0xffff : 0;
+
+	if (cmd & CRC_BLOCK) {
+
+		uint8_t bank = regs[2] == CRC_BANK_RUN ? *run_bank : regs[2];
+		uint32_t adr = REG16(0) & (size - 1);
+		uint32_t len = REG16(3);
+
+		status &= ~CRC_BAD_BANK;
+
+		if (bank >= nbanks) {
+			status |= CRC_BAD_BANK;
+			return;
+		}
+
+		if (len > size)
+			len = size;
+
+		// wraps inside the bank
+		uint32_t run = adr + len > size ? size - adr : len;
+
+		block(ram + bank * size, adr, run);
+		block(ram + bank * size, 0, len - run);
+
+		uint32_t end = REG16(0) + len;
+		regs[0] = end;
+		regs[1] = end >> 8;
+	}
+}
+
+//
+//
+//
+
+void z80_crc_init(const uint8_t *mem, uint32_t bank_size, uint8_t banks, const uint8_t *run) {
+
+	ram = mem;
+	size = bank_size;
+	nbanks = banks;
+	run_bank = run;
+
+	tables();
+
+	dma_chan = dma_claim_unused_channel(false);
+
+	z80_crc_reset();
+}
+
+void z80_crc_reset(void) {
+	memset(regs, 0, sizeof(regs));
+	regs[2] = CRC_BANK_RUN;
+	algo = CRC_16;
+	value = 0xffff;
+	status = 0;
+}
+
+//
+// Registers
+//
+
+bool z80_crc_read(uint16_t adr, uint8_t *val) {
+
+	if (adr < CRC_BASE || adr >= CRC_BASE + CRC_REGS)
+		return false;
+
+	int reg = adr - CRC_BASE;
+
+	if (reg >= RESULT)
+		*val = value >> (8 * (reg - RESULT));
+	else if (reg == 5)
+		*val = status | algo;
+	else
+		*val = regs[reg];
+
+	return true;
+}
+
+bool z80_crc_write(uint16_t adr, uint8_t val) {
+
+	if (adr < CRC_BASE || adr >= CRC_BASE + CRC_REGS)
+		return false;
+
+	int reg = adr - CRC_BASE;
+
+	if (reg >= RESULT) {
+		int shift = 8 * (reg - RESULT);
+		value = (value & ~(0xffu << shift)) | (uint32_t)val << shift;
+	} else if (reg == 5) {
+		command(val);
+	} else if (reg == 6) {
+		feed(val);
+	} else {
+		regs[reg] = val;
+	}
+
+	return true;
+}
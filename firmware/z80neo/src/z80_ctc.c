@@ -0,0 +1,212 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <hardware/timer.h>
+#include <pico/stdlib.h>
+
+#include "z80_ctc.h"
+#include "z80_int.h"
+
+// control word
+#define CTC_INT (1 << 7)
+#define CTC_COUNTER (1 << 6)
+#define CTC_PRESCALE_256 (1 << 5)
+#define CTC_TC (1 << 2)
+#define CTC_RESET (1 << 1)
+#define CTC_CONTROL (1 << 0)
+
+typedef struct {
+	uint8_t control;
+	bool wait_tc;
+	volatile bool running;
+
+	uint16_t tc;	 // 1 - 256
+	uint16_t reload; // taken at the next zero crossing
+	volatile uint16_t count;
+
+	// timer mode, in CTC clocks from start_us
+	uint64_t start_us;
+	uint64_t cycles;
+	volatile uint32_t zero_us; // last zero crossing
+	volatile uint32_t rate;	   // counts per us, 16.16
+} ctc_channel;
+
+static ctc_channel ctc[CTC_CHANNELS];
+static uint16_t ctc_base = CTC_BASE;
+static uint32_t ctc_clock = CTC_CLOCK;
+
+//
+// Channels
+//
+
+static uint32_t prescale(const ctc_channel *ch) {
+	return ch->control & CTC_PRESCALE_256 ? 256 : 16;
+}
+
+static uint64_t step(const ctc_channel *ch) {
+
+	uint64_t cycles = (uint64_t)prescale(ch) * ch->tc;
+	uint64_t min = (uint64_t)CTC_MIN_US * ctc_clock / 1000000;
+
+	return cycles < min ? min : cycles;
+}
+
+static uint64_t due_us(const ctc_channel *ch) {
+	return ch->start_us + ch->cycles * 1000000 / ctc_clock;
+}
+
+// ZC/TO: reload, interrupt, and one count for the next channel
+static void zero(int n, uint64_t when) {
+
+	ctc_channel *ch = &ctc[n];
+
+	ch->tc = ch->reload;
+	ch->count = ch->tc;
+	ch->zero_us = (uint32_t)when;
+
+	if (ch->control & CTC_INT)
+		z80_int_raise(INT_CTC(n));
+
+	if (n + 1 < CTC_CHANNELS) {
+		ctc_channel *next = &ctc[n + 1];
+		if (next->running && (next->control & CTC_COUNTER) && --next->count == 0)
+			zero(n + 1, when);
+	}
+}
+
+static void timer_alarm(uint n) {
+
+	ctc_channel *ch = &ctc[n];
+	int late = 0;
+
+	if (!ch->running)
+		return;
+
+	for (;;) {
+
+		zero(n, due_us(ch));
+		ch->cycles += step(ch);
+
+		if (!timer_hardware_alarm_set_target(timer1_hw, n, from_us_since_boot(due_us(ch))))
+			return;
+
+		// the target went by already, after a few in a row give up on the
+		// lost periods and count from now
+		if (++late > 4) {
+			ch->start_us = timer_time_us_64(timer1_hw);
+			ch->cycles = 0;
+		}
+	}
+}
+
+static void channel_start(int n) {
+
+	ctc_channel *ch = &ctc[n];
+
+	ch->tc = ch->reload;
+	ch->count = ch->tc;
+	ch->running = true;
+
+	if (ch->control & CTC_COUNTER)
+		return;
+
+	ch->start_us = timer_time_us_64(timer1_hw);
+	ch->zero_us = (uint32_t)ch->start_us;
+	ch->cycles = step(ch);
+
+	if (timer_hardware_alarm_set_target(timer1_hw, n, from_us_since_boot(due_us(ch))))
+		timer_alarm(n);
+}
+
+static void channel_stop(int n) {
+	ctc[n].running = false;
+	timer_hardware_alarm_cancel(timer1_hw, n);
+}
+
+//
+// Setup, core0: the alarm interrupts are taken by the core that sets them up,
+// the same as the bus ISR
+//
+
+void z80_ctc_init(uint16_t base, uint32_t clock_hz) {
+
+	ctc_base = base;
+	if (clock_hz)
+		ctc_clock = clock_hz;
+
+	for (int n = 0; n < CTC_CHANNELS; n++) {
+		timer_hardware_alarm_claim(timer1_hw, n);
+		timer_hardware_alarm_set_callback(timer1_hw, n, timer_alarm);
+	}
+
+	z80_ctc_reset();
+}
+
+void z80_ctc_reset(void) {
+
+	for (int n = 0; n < CTC_CHANNELS; n++) {
+		channel_stop(n);
+		ctc[n].control = 0;
+		ctc[n].wait_tc = false;
+		ctc[n].tc = ctc[n].reload = 256;
+		ctc[n].count = 0;
+	}
+}
+
+//
+// Registers
+//
+
+bool z80_ctc_read(uint16_t adr, uint8_t *val) {
+
+	if (adr < ctc_base || adr >= ctc_base + CTC_CHANNELS)
+		return false;
+
+	ctc_channel *ch = &ctc[adr - ctc_base];
+
+	if (ch->running && !(ch->control & CTC_COUNTER)) {
+		uint32_t done = ((uint64_t)(timer_time_us_32(timer1_hw) - ch->zero_us) * ch->rate) >> 16;
+		*val = done < ch->tc ? ch->tc - done : 1;
+	} else {
+		*val = ch->count;
+	}
+
+	return true;
+}
+
+bool z80_ctc_write(uint16_t adr, uint8_t val) {
+
+	if (adr < ctc_base || adr >= ctc_base + CTC_CHANNELS)
+		return false;
+
+	int n = adr - ctc_base;
+	ctc_channel *ch = &ctc[n];
+
+	if (ch->wait_tc) {
+
+		ch->wait_tc = false;
+		ch->reload = val ? val : 256;
+
+		if (!ch->running)
+			channel_start(n);
+
+	} else if (val & CTC_CONTROL) {
+
+		if (val & CTC_RESET)
+			channel_stop(n);
+
+		ch->control = val;
+		ch->wait_tc = (val & CTC_TC) != 0;
+		ch->rate = ((uint64_t)ctc_clock << 16) / (prescale(ch) * 1000000);
+
+		z80_int_mask(INT_CTC(n), (val & CTC_INT) != 0);
+
+	} else if (n == 0) {
+
+		// vector, the channel number goes in bits 2-1
+		for (int c = 0; c < CTC_CHANNELS; c++)
+			z80_int_vector(INT_CTC_SRC + c, (val & 0xf8) | (c << 1));
+	}
+
+	return true;
+}
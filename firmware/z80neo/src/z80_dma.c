@@ -0,0 +1,175 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <pico/stdlib.h>
+
+#include "z80_dma.h"
+
+static uint8_t *ram = NULL;
+static uint32_t size = 0;
+static uint8_t nbanks = 0;
+static const uint8_t *run_bank = NULL;
+static volatile uint32_t *ram_seq = NULL;
+
+static uint8_t regs[DMA_REGS];
+static uint8_t status = 0;
+
+#define REG16(r) (regs[r] | (regs[(r) + 1] << 8))
+
+//
+//
+//
+
+void z80_dma_init(uint8_t *mem, uint32_t bank_size, uint8_t banks,
+				  const uint8_t *run, volatile uint32_t *seq) {
+
+	ram = mem;
+	size = bank_size;
+	nbanks = banks;
+	run_bank = run;
+	ram_seq = seq;
+
+	z80_dma_reset();
+}
+
+void z80_dma_reset(void) {
+	memset(regs, 0, sizeof(regs));
+	regs[2] = DMA_BANK_RUN;
+	regs[5] = DMA_BANK_RUN;
+	status = 0;
+}
+
+static uint8_t *bank_of(uint8_t reg) {
+
+	uint8_t bank = regs[reg] == DMA_BANK_RUN ? *run_bank : regs[reg];
+
+	return bank < nbanks ? ram + bank * size : NULL;
+}
+
+static void set16(int reg, uint32_t val) {
+	regs[reg] = val;
+	regs[reg + 1] = val >> 8;
+}
+
+//
+// Operations, straight memcpy/memset/memcmp unless the block wraps or
+// overlaps the LDIR way, then byte by byte
+//
+
+static void copy(uint8_t *s, uint8_t *d, uint32_t src, uint32_t dst, uint32_t len) {
+
+	uint32_t mask = size - 1;
+	bool wraps = src + len > size || dst + len > size;
+	bool ripple = s == d && dst > src && dst < src + len;
+
+	*ram_seq += 1;
+	__dmb();
+
+	if (!wraps && !ripple) {
+		memmove(d + dst, s + src, len);
+	} else {
+		for (uint32_t i = 0; i < len; i++)
+			d[(dst + i) & mask] = s[(src + i) & mask];
+	}
+
+	__dmb();
+	*ram_seq += 1;
+}
+
+static void fill(uint8_t *d, uint32_t dst, uint32_t len, uint8_t val) {
+
+	uint32_t run = dst + len > size ? size - dst : len;
+
+	*ram_seq += 1;
+	__dmb();
+
+	memset(d + dst, val, run);
+	memset(d, val, len - run);
+
+	__dmb();
+	*ram_seq += 1;
+}
+
+static uint32_t compare(const uint8_t *s, const uint8_t *d, uint32_t src, uint32_t dst,
+						uint32_t len) {
+
+	uint32_t mask = size - 1;
+
+	if (src + len <= size && dst + len <= size && memcmp(s + src, d + dst, len) == 0)
+		return len;
+
+	for (uint32_t i = 0; i < len; i++)
+		if (s[(src + i) & mask] != d[(dst + i) & mask])
+			return i;
+
+	return len;
+}
+
+static void command(uint8_t cmd) {
+
+	uint8_t *s = bank_of(2);
+	uint8_t *d = bank_of(5);
+	uint32_t src = REG16(0) & (size - 1);
+	uint32_t dst = REG16(3) & (size - 1);
+	uint32_t len = REG16(6);
+
+	if (len > size)
+		len = size;
+
+	status &= ~DMA_BAD_BANK;
+
+	if (!d || (!s && cmd != DMA_FILL)) {
+		status |= DMA_BAD_BANK;
+		return;
+	}
+
+	switch (cmd) {
+	case DMA_COPY:
+		copy(s, d, src, dst, len);
+		set16(0, REG16(0) + len);
+		set16(3, REG16(3) + len);
+		break;
+	case DMA_FILL:
+		fill(d, dst, len, regs[8]);
+		break;
+	case DMA_COMPARE: {
+		uint32_t at = compare(s, d, src, dst, len);
+		set16(10, at);
+		if (at == len)
+			status |= DMA_EQUAL;
+		else
+			status &= ~DMA_EQUAL;
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+//
+// Registers
+//
+
+bool z80_dma_read(uint16_t adr, uint8_t *val) {
+
+	if (adr < DMA_BASE || adr >= DMA_BASE + DMA_REGS)
+		return false;
+
+	*val = adr == DMA_BASE + 9 ? status : regs[adr - DMA_BASE];
+
+	return true;
+}
+
+bool z80_dma_write(uint16_t adr, uint8_t val) {
+
+	if (adr < DMA_BASE || adr >= DMA_BASE + DMA_REGS)
+		return false;
+
+	if (adr == DMA_BASE + 9)
+		command(val);
+	else if (adr < DMA_BASE + 10)
+		regs[adr - DMA_BASE] = val;
+
+	return true;
+}
@@ -0,0 +1,209 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <hardware/gpio.h>
+#include <hardware/sync.h>
+#include <pico/stdlib.h>
+#include <pico/time.h>
+
+#include "z80_int.h"
+
+static int int_pin = -1;
+static int nmi_pin = -1;
+
+static volatile uint8_t enable = 0;
+static volatile uint8_t pending = 0; // edge sources, set from either core
+static volatile uint8_t levels = 0;	 // level sources, core0
+static volatile uint8_t vector = 0;
+static volatile uint8_t button = 0;
+static volatile uint8_t period = 0;
+static uint8_t own_vector[INT_SOURCES];
+static volatile uint8_t owned = 0;
+static bool asserted = false;
+
+static repeating_timer_t timer;
+static bool timer_on = false;
+
+//
+// /INT
+//
+
+// The line belongs to core0, where the bus ISR and the timer run. Changes
+// made on core1 (buttons, a reset from the UI) are picked up by core0's next
+// z80_int_levels().
+static void line_update(void) {
+
+	if (get_core_num() != 0)
+		return;
+
+	uint32_t irq = save_and_disable_interrupts();
+
+	bool active = ((pending | levels) & enable) != 0;
+
+	if (active != asserted) {
+		asserted = active;
+		if (int_pin >= 0)
+			gpio_set_dir(int_pin, active ? GPIO_OUT : GPIO_IN);
+	}
+
+	restore_interrupts(irq);
+}
+
+void z80_int_init(int int_gpio, int nmi_gpio) {
+
+	int_pin = int_gpio;
+	nmi_pin = nmi_gpio;
+
+	// released, low when the direction turns to output
+	if (int_pin >= 0) {
+		gpio_init(int_pin);
+		gpio_put(int_pin, 0);
+	}
+
+	if (nmi_pin >= 0) {
+		gpio_init(nmi_pin);
+		gpio_put(nmi_pin, 0);
+	}
+}
+
+void z80_int_raise(uint8_t sources) {
+	__atomic_fetch_or(&pending, sources, __ATOMIC_RELAXED);
+	line_update();
+}
+
+void z80_int_levels(uint8_t sources) {
+	levels = sources;
+	line_update();
+}
+
+void z80_int_button(uint8_t b) {
+	button = b;
+	z80_int_raise(INT_BUTTON);
+}
+
+void z80_int_mask(uint8_t sources, bool on) {
+
+	if (on)
+		__atomic_fetch_or(&enable, sources, __ATOMIC_RELAXED);
+	else
+		__atomic_fetch_and(&enable, (uint8_t)~sources, __ATOMIC_RELAXED);
+
+	line_update();
+}
+
+void z80_int_vector(int src, uint8_t vec) {
+	own_vector[src] = vec;
+	__atomic_fetch_or(&owned, (uint8_t)(1 << src), __ATOMIC_RELAXED);
+}
+
+//
+// Acknowledge, from the bus ISR
+//
+
+uint8_t z80_int_ack(void) {
+
+	uint8_t active = (pending | levels) & enable;
+
+	// nothing left (released between the request and the acknowledge), the
+	// last vector of the table
+	int src = active ? __builtin_ctz(active) : INT_SOURCES - 1;
+
+	__atomic_fetch_and(&pending, (uint8_t)~(1 << src), __ATOMIC_RELAXED);
+
+	line_update();
+
+	if (owned & (1 << src))
+		return own_vector[src];
+
+	return (vector & ~((INT_SOURCES << 1) - 1)) | (src << 1);
+}
+
+//
+// /NMI, edge triggered, held for the us given so the Z80 sees it
+//
+
+static int64_t nmi_release(alarm_id_t id, void *user) {
+	gpio_set_dir(nmi_pin, GPIO_IN);
+	return 0;
+}
+
+void z80_int_nmi(uint32_t us) {
+
+	if (nmi_pin < 0)
+		return;
+
+	gpio_set_dir(nmi_pin, GPIO_OUT);
+	add_alarm_in_us(us, nmi_release, NULL, true);
+}
+
+//
+// Timer
+//
+
+static bool timer_tick(repeating_timer_t *rt) {
+	z80_int_raise(INT_TIMER);
+	return true;
+}
+
+static void timer_set(uint8_t ticks) {
+
+	if (timer_on)
+		cancel_repeating_timer(&timer);
+
+	period = ticks;
+	timer_on = ticks && add_repeating_timer_ms(-10 * (int32_t)ticks, timer_tick, NULL, &timer);
+}
+
+void z80_int_reset(void) {
+	timer_set(0);
+	enable = 0;
+	pending = 0;
+	vector = 0;
+	owned = 0;
+	line_update();
+}
+
+//
+// Registers
+//
+
+bool z80_int_read(uint16_t adr, uint8_t *val) {
+
+	if (adr < INT_BASE || adr >= INT_BASE + INT_REGS)
+		return false;
+
+	switch (adr - INT_BASE) {
+	case 0:
+		*val = pending | levels;
+		break;
+	case 1:
+		*val = vector;
+		break;
+	default:
+		*val = button;
+		break;
+	}
+
+	return true;
+}
+
+bool z80_int_write(uint16_t adr, uint8_t val) {
+
+	if (adr < INT_BASE || adr >= INT_BASE + INT_REGS)
+		return false;
+
+	switch (adr - INT_BASE) {
+	case 0:
+		enable = val;
+		line_update();
+		break;
+	case 1:
+		vector = val;
+		break;
+	default:
+		timer_set(val);
+		break;
+	}
+
+	return true;
+}
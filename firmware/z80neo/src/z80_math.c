@@ -0,0 +1,143 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "z80_math.h"
+
+static uint8_t regs[MATH_REGS];
+static uint8_t status = 0;
+
+#define OP_A 0
+#define OP_B 4
+#define OP 8
+#define RESULT 9
+
+static uint32_t get32(int reg) {
+	return regs[reg] | regs[reg + 1] << 8 | regs[reg + 2] << 16 | (uint32_t)regs[reg + 3] << 24;
+}
+
+static void put64(uint64_t val) {
+	for (int i = 0; i < 8; i++)
+		regs[RESULT + i] = val >> (8 * i);
+}
+
+// quotient in the low word, remainder in the high one
+static uint64_t div_result(uint32_t q, uint32_t r) { return q | (uint64_t)r << 32; }
+
+void z80_math_reset(void) {
+	memset(regs, 0, sizeof(regs));
+	status = 0;
+}
+
+//
+// Operations
+//
+
+static uint32_t isqrt(uint32_t a) {
+
+	uint32_t root = 0;
+	uint32_t bit = 1u << 30;
+
+	while (bit > a)
+		bit >>= 2;
+
+	while (bit) {
+		if (a >= root + bit) {
+			a -= root + bit;
+			root = (root >> 1) + bit;
+		} else {
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+
+	return root;
+}
+
+static void run(uint8_t op) {
+
+	uint32_t a = get32(OP_A);
+	uint32_t b = get32(OP_B);
+	uint64_t res = 0;
+	bool err = false;
+
+	switch (op) {
+	case MATH_MUL16:
+		res = (uint32_t)(uint16_t)a * (uint16_t)b;
+		break;
+	case MATH_MULS16:
+		res = (uint32_t)((int32_t)(int16_t)a * (int16_t)b);
+		break;
+	case MATH_MUL32:
+		res = (uint64_t)a * b;
+		break;
+	case MATH_MULS32:
+		res = (uint64_t)((int64_t)(int32_t)a * (int32_t)b);
+		break;
+	case MATH_DIV16:
+		if (!(err = (uint16_t)b == 0))
+			res = div_result((uint16_t)a / (uint16_t)b, (uint16_t)a % (uint16_t)b);
+		break;
+	case MATH_DIVS16:
+		// -32768 / -1 doesn't fit in 16 bits
+		if (!(err = (int16_t)b == 0 || ((int16_t)a == INT16_MIN && (int16_t)b == -1)))
+			res = div_result((uint16_t)((int16_t)a / (int16_t)b),
+							 (uint16_t)((int16_t)a % (int16_t)b));
+		break;
+	case MATH_DIV32:
+		if (!(err = b == 0))
+			res = div_result(a / b, a % b);
+		break;
+	case MATH_DIVS32:
+		if (!(err = b == 0 || ((int32_t)a == INT32_MIN && (int32_t)b == -1)))
+			res = div_result((int32_t)a / (int32_t)b, (int32_t)a % (int32_t)b);
+		break;
+	case MATH_SQRT: {
+		uint32_t root = isqrt(a);
+		res = div_result(root, a - root * root);
+		break;
+	}
+	case MATH_FIXMUL:
+		res = (uint32_t)(((int64_t)(int32_t)a * (int32_t)b) >> 16);
+		break;
+	case MATH_FIXDIV: {
+		int64_t q = b ? (int64_t)(int32_t)a * 65536 / (int32_t)b : 0;
+		if (!(err = b == 0 || q > INT32_MAX || q < INT32_MIN))
+			res = (uint32_t)q;
+		break;
+	}
+	default:
+		err = true;
+		break;
+	}
+
+	status = err ? MATH_ERROR : 0;
+	put64(err ? 0 : res);
+}
+
+//
+// Registers
+//
+
+bool z80_math_read(uint16_t adr, uint8_t *val) {
+
+	if (adr < MATH_BASE || adr >= MATH_BASE + MATH_REGS)
+		return false;
+
+	*val = adr == MATH_BASE + OP ? status : regs[adr - MATH_BASE];
+
+	return true;
+}
+
+bool z80_math_write(uint16_t adr, uint8_t val) {
+
+	if (adr < MATH_BASE || adr >= MATH_BASE + MATH_REGS)
+		return false;
+
+	if (adr == MATH_BASE + OP)
+		run(val);
+	else if (adr < MATH_BASE + OP)
+		regs[adr - MATH_BASE] = val;
+
+	return true;
+}
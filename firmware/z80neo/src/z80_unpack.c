@@ -0,0 +1,120 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <pico/stdlib.h>
+
+#include "unpack.h"
+#include "z80_unpack.h"
+
+static uint8_t *ram = NULL;
+static uint32_t size = 0;
+static uint8_t nbanks = 0;
+static const uint8_t *run_bank = NULL;
+static volatile uint32_t *ram_seq = NULL;
+
+static uint8_t regs[UNPACK_REGS];
+static uint8_t status = 0;
+
+#define REG16(r) (regs[r] | (regs[(r) + 1] << 8))
+
+#define FORMAT 6
+#define COUNT 7
+#define TIME 11
+
+void z80_unpack_init(uint8_t *mem, uint32_t bank_size, uint8_t banks,
+					 const uint8_t *run, volatile uint32_t *seq) {
+
+	ram = mem;
+	size = bank_size;
+	nbanks = banks;
+	run_bank = run;
+	ram_seq = seq;
+
+	z80_unpack_reset();
+}
+
+void z80_unpack_reset(void) {
+	memset(regs, 0, sizeof(regs));
+	regs[2] = UNPACK_BANK_RUN;
+	regs[5] = UNPACK_BANK_RUN;
+	status = 0;
+}
+
+static uint8_t *bank_of(uint8_t reg) {
+
+	uint8_t bank = regs[reg] == UNPACK_BANK_RUN ? *run_bank : regs[reg];
+
+	return bank < nbanks ? ram + bank * size : NULL;
+}
+
+static void put(int reg, uint32_t val, int n) {
+	for (int i = 0; i < n; i++)
+		regs[reg + i] = val >> (8 * i);
+}
+
+static void run(uint8_t format) {
+
+	uint8_t *s = bank_of(2);
+	uint8_t *d = bank_of(5);
+	uint32_t src = REG16(0) & (size - 1);
+	uint32_t dst = REG16(3) & (size - 1);
+	uint32_t src_len = size - src;
+	uint32_t len = REG16(9);
+
+	if (len && len < src_len)
+		src_len = len;
+
+	put(COUNT, 0, 2);
+
+	if (!s || !d) {
+		status = UNPACK_BAD_BANK;
+		return;
+	}
+
+	uint32_t start = time_us_32();
+
+	*ram_seq += 1;
+	__dmb();
+
+	int n = unpack(format, s + src, src_len, d + dst, size - dst);
+
+	__dmb();
+	*ram_seq += 1;
+
+	put(TIME, time_us_32() - start, 4);
+
+	status = n < 0 ? UNPACK_FAILED : 0;
+	// a whole 64 KB bank wraps to 0, see z80_unpack.h
+	if (n > 0)
+		put(COUNT, n, 2);
+}
+
+//
+// Registers
+//
+
+bool z80_unpack_read(uint16_t adr, uint8_t *val) {
+
+	if (adr < UNPACK_BASE || adr >= UNPACK_BASE + UNPACK_REGS)
+		return false;
+
+	*val = adr == UNPACK_BASE + FORMAT ? status : regs[adr - UNPACK_BASE];
+
+	return true;
+}
+
+bool z80_unpack_write(uint16_t adr, uint8_t val) {
+
+	if (adr < UNPACK_BASE || adr >= UNPACK_BASE + UNPACK_REGS)
+		return false;
+
+	int reg = adr - UNPACK_BASE;
+
+	if (reg == FORMAT)
+		run(val);
+	else if (reg < COUNT || reg == 9 || reg == 10)
+		regs[reg] = val;
+
+	return true;
+}
@@ -0,0 +1,220 @@
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "fmt.h"
+
+// from the SDK, the panel defines in ssd1306_i2c.h use it
+#define _u(x) x##u
+
+#include "ssd1306_font.h"
+#include "ssd1306_i2c.h"
+
+// UI frame cost on the host, the text path before and after user-035.
+//
+// A frame is what display_loop() draws every tick in the bus view plus one
+// TB-MON page: the status line, the five bus fields and four rows of bytes.
+// "before" is the old code, copied here since it's gone from the tree:
+// vsnprintf into text_buffer, strcpy into the screen line and WriteChar()
+// through the lazily filled font copy with toupper(). "after" is fmt.c and
+// ssd1306_text.c as built for the board.
+
+#define TEXT_BUFFER_SIZE 256
+#define LINES 4
+#define BYTES_PER_ROW 4
+
+static uint8_t buf[SSD1306_BUF_LEN];
+static char text_buffer[TEXT_BUFFER_SIZE];
+static char screen[LINES][TEXT_BUFFER_SIZE];
+static uint8_t ram[256];
+
+typedef struct {
+	uint8_t bank;
+	uint16_t m_adr, low_adr, high_adr;
+	uint8_t r_op, w_op;
+} bus_state;
+
+//
+// Before
+//
+
+static uint8_t reversed[sizeof(font)] = {0};
+
+static void old_fill_reversed_cache(void) {
+	for (size_t i = 0; i < sizeof(font); i++)
+		reversed[i] = font[i];
+}
+
+static void old_write_char(uint8_t *display_buf, int16_t x, int16_t y, uint8_t ch) {
+
+	if (reversed[0] == 0)
+		old_fill_reversed_cache();
+
+	if (x > SSD1306_WIDTH - 8 || y > SSD1306_HEIGHT - 8)
+		return;
+
+	y = y / 8;
+
+	ch = toupper(ch);
+	int idx = ch - 32;
+	int fb_idx = y * 128 + x;
+
+	for (int i = 0; i < 8; i++)
+		display_buf[fb_idx++] = reversed[idx * 8 + i];
+}
+
+static void old_write_string(uint8_t *display_buf, int16_t x, int16_t y, char *str) {
+
+	if (x > SSD1306_WIDTH - 8 || y > SSD1306_HEIGHT - 8)
+		return;
+
+	// the old loop ran off the panel, stopped here to keep buf in bounds
+	while (*str && x <= SSD1306_WIDTH - 8) {
+		old_write_char(display_buf, x, y, *str++);
+		x += 8;
+	}
+}
+
+static void old_print_string0(int x, int y, char *text, ...) {
+
+	va_list args;
+	va_start(args, text);
+	vsnprintf(text_buffer, TEXT_BUFFER_SIZE, text, args);
+	strcpy(screen[y], text_buffer);
+	old_write_string(buf, x * 8, y * 8, text_buffer);
+	va_end(args);
+}
+
+static void frame_before(const bus_state *bus, int idx) {
+
+	sprintf(text_buffer, "%1x:%04x O:%02x I:%02x", bus->bank, bus->m_adr, bus->w_op,
+			bus->r_op);
+	old_write_string(buf, 0, 0, text_buffer);
+
+	old_print_string0(0, 0, "L:%04x", bus->low_adr);
+	old_print_string0(0, 1, "H:%04x", bus->high_adr);
+	old_print_string0(0, 2, "&:%04x", bus->m_adr);
+	old_print_string0(0, 3, "R:%02x", bus->r_op);
+	old_print_string0(8, 3, "W:%02x", bus->w_op);
+
+	for (int line = 0; line < LINES; line++) {
+
+		char row[32];
+		char byte_data[4];
+		int offset = idx + line * BYTES_PER_ROW;
+
+		sprintf(row, "%04x ", offset);
+		for (int col = 0; col < BYTES_PER_ROW; col++) {
+			sprintf(byte_data, col < 3 ? "%02x:" : "%02x", ram[(offset + col) & 0xff]);
+			strcat(row, byte_data);
+		}
+
+		old_print_string0(0, line, row);
+	}
+}
+
+//
+// After
+//
+
+static void print_text0(int x, int y, const char *text) {
+	fmt_str(screen[y], text);
+	WriteString(buf, x * 8, y * 8, screen[y]);
+}
+
+static void frame_after(const bus_state *bus, int idx) {
+
+	char *p = fmt_hex(text_buffer, bus->bank, 1);
+	p = fmt_str(p, ":");
+	p = fmt_hex(p, bus->m_adr, 4);
+	p = fmt_str(p, " O:");
+	p = fmt_hex(p, bus->w_op, 2);
+	p = fmt_str(p, " I:");
+	fmt_hex(p, bus->r_op, 2);
+	WriteString(buf, 0, 0, text_buffer);
+
+	fmt_hex(fmt_str(text_buffer, "L:"), bus->low_adr, 4);
+	print_text0(0, 0, text_buffer);
+	fmt_hex(fmt_str(text_buffer, "H:"), bus->high_adr, 4);
+	print_text0(0, 1, text_buffer);
+	fmt_hex(fmt_str(text_buffer, "&:"), bus->m_adr, 4);
+	print_text0(0, 2, text_buffer);
+	fmt_hex(fmt_str(text_buffer, "R:"), bus->r_op, 2);
+	print_text0(0, 3, text_buffer);
+	fmt_hex(fmt_str(text_buffer, "W:"), bus->w_op, 2);
+	print_text0(8, 3, text_buffer);
+
+	for (int line = 0; line < LINES; line++) {
+
+		int offset = idx + line * BYTES_PER_ROW;
+		p = fmt_hex(text_buffer, offset, 4);
+
+		for (int col = 0; col < BYTES_PER_ROW; col++) {
+			p = fmt_str(p, col ? ":" : " ");
+			p = fmt_hex(p, ram[(offset + col) & 0xff], 2);
+		}
+
+		print_text0(0, line, text_buffer);
+	}
+}
+
+//
+//
+//
+
+static double now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+#define FRAMES 200000
+
+static double run(void (*frame)(const bus_state *, int), uint8_t *out) {
+
+	bus_state bus = {0};
+
+	memset(buf, 0, sizeof(buf));
+
+	double start = now_ns();
+
+	for (int i = 0; i < FRAMES; i++) {
+		bus.bank = i & 7;
+		bus.m_adr = i * 7;
+		bus.low_adr = i;
+		bus.high_adr = i >> 3;
+		bus.r_op = i * 3;
+		bus.w_op = i * 5;
+		frame(&bus, i & 0x7ff0);
+	}
+
+	double ns = (now_ns() - start) / FRAMES;
+
+	memcpy(out, buf, sizeof(buf));
+
+	return ns;
+}
+
+int main(void) {
+
+	static uint8_t before_buf[SSD1306_BUF_LEN];
+	static uint8_t after_buf[SSD1306_BUF_LEN];
+
+	for (size_t i = 0; i < sizeof(ram); i++)
+		ram[i] = i * 37;
+
+	double before = run(frame_before, before_buf);
+	double after = run(frame_after, after_buf);
+
+	// the same pixels both ways
+	int same = memcmp(before_buf, after_buf, sizeof(before_buf)) == 0;
+
+	printf("frame before %7.0f ns\n", before);
+	printf("frame after  %7.0f ns  (%.1fx)\n", after, before / after);
+	printf("framebuffers %s\n", same ? "match" : "DIFFER");
+
+	return !same;
+}
@@ -0,0 +1,89 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "z80_crc.h"
+
+// z80_crc.c on the host, driven through its registers like crc_test.s does.
+//
+// Reads a vector from stdin, puts it at VECTOR in the running bank and prints
+// one line per algorithm (CRC-16, CRC-32, Fletcher-16): the result over the
+// block, the same bytes through the data port, and the block again from a
+// copy that wraps at the end of the bank:
+//
+//   bbbbbbbb pppppppp wwwwwwww
+//
+// crc_host_tables is built without a free DMA channel, so the blocks go
+// through the tables too. crc_vectors.py --host compares the lines with its
+// references.
+
+#define MAX_BANKS 2
+#define RAM_SIZE 32768
+#define VECTOR 0x1000
+
+static uint8_t ram[MAX_BANKS][RAM_SIZE];
+static uint8_t run_bank = 1;
+
+static void put16(uint16_t adr, uint16_t v) {
+	z80_crc_write(adr, v & 0xff);
+	z80_crc_write(adr + 1, v >> 8);
+}
+
+static uint32_t result(void) {
+
+	uint32_t v = 0;
+
+	for (int i = 3; i >= 0; i--) {
+		uint8_t b;
+		z80_crc_read(CRC_BASE + 7 + i, &b);
+		v = v << 8 | b;
+	}
+
+	return v;
+}
+
+static uint32_t block(uint8_t algo, uint16_t adr, uint16_t len) {
+	put16(CRC_BASE, adr);
+	put16(CRC_BASE + 3, len);
+	z80_crc_write(CRC_BASE + 5, algo | CRC_RESTART | CRC_BLOCK);
+	return result();
+}
+
+int main(void) {
+
+	static uint8_t data[RAM_SIZE];
+	size_t len = fread(data, 1, sizeof(data), stdin);
+
+	if (len > RAM_SIZE - VECTOR) {
+		fprintf(stderr, "vector over %d bytes\n", RAM_SIZE - VECTOR);
+		return 1;
+	}
+
+	memcpy(&ram[run_bank][VECTOR], data, len);
+
+	// split over the end of the bank
+	uint16_t wrap = RAM_SIZE - len / 2;
+	for (size_t i = 0; i < len; i++)
+		ram[0][(wrap + i) & (RAM_SIZE - 1)] = data[i];
+
+	z80_crc_init(&ram[0][0], RAM_SIZE, MAX_BANKS, &run_bank);
+
+	for (uint8_t algo = CRC_16; algo <= CRC_FLETCHER; algo++) {
+
+		uint32_t b = block(algo, VECTOR, len);
+
+		z80_crc_write(CRC_BASE + 5, algo | CRC_RESTART);
+		for (size_t i = 0; i < len; i++)
+			z80_crc_write(CRC_BASE + 6, data[i]);
+		uint32_t p = result();
+
+		z80_crc_write(CRC_BASE + 2, 0);
+		uint32_t w = block(algo, wrap, len);
+		z80_crc_write(CRC_BASE + 2, CRC_BANK_RUN);
+
+		printf("%08X %08X %08X\n", b, p, w);
+	}
+
+	return 0;
+}
@@ -0,0 +1,255 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "proto.h"
+
+// The board's end of proto.h on a pseudo terminal, so z80neo.py can be run
+// against proto.c without hardware:
+//
+//   proto_loopback &          prints the pty to open
+//   z80neo.py loopback ./proto_loopback
+//
+// Input goes into a FIFO and is taken out the way host_rx_task() in main.c
+// does it: text a byte at a time up to the line end, frames only as far as
+// proto_wanted() says. RAM is MAX_BANKS banks of RAM_SIZE like the board.
+// BANK, RESET and RUN answer at once. Text commands are echoed back as
+// "TEXT <line>", an over-long one as "ERR LINE", so the host can check where
+// text ends and frames start.
+
+#define MAX_BANKS 8
+#define RAM_SIZE 32768
+
+static uint8_t ram[MAX_BANKS][RAM_SIZE];
+static uint8_t cur_bank = 0;
+
+// USB side, what tud_cdc_n_read() would hand out
+static uint8_t fifo[4096];
+static size_t fifo_head = 0;
+static size_t fifo_tail = 0;
+
+static proto_parser parser;
+static proto_line line;
+
+static uint8_t tx[PROTO_MAX_PAYLOAD + PROTO_OVERHEAD];
+static uint8_t data[PROTO_MAX_DATA];
+
+static int fd;
+
+static size_t fifo_available(void) { return fifo_head - fifo_tail; }
+
+static size_t fifo_read(uint8_t *out, size_t n) {
+
+	if (n > fifo_available())
+		n = fifo_available();
+
+	memcpy(out, fifo + fifo_tail, n);
+	fifo_tail += n;
+
+	if (fifo_tail == fifo_head)
+		fifo_head = fifo_tail = 0;
+
+	return n;
+}
+
+static void send_all(const void *p, size_t len) {
+
+	const uint8_t *b = p;
+
+	while (len) {
+		ssize_t n = write(fd, b, len);
+		if (n < 0) {
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			perror("write");
+			exit(1);
+		}
+		b += n;
+		len -= n;
+	}
+}
+
+static void reply(const proto_frame *f, uint8_t status, const uint8_t *d, uint16_t len) {
+	send_all(tx, proto_encode(tx, sizeof(tx), f->cmd | PROTO_REPLY, f->seq, status, d,
+							  status == PROTO_OK ? len : 0));
+}
+
+// host_frame() without the core1 hand over
+static void frame(const proto_frame *f) {
+
+	const uint8_t *p = f->payload;
+	uint16_t adr, n;
+
+	switch (f->cmd) {
+	case PROTO_PING:
+		data[0] = PROTO_VERSION;
+		data[1] = MAX_BANKS;
+		data[2] = RAM_SIZE & 0xFF;
+		data[3] = RAM_SIZE >> 8;
+		data[4] = PROTO_MAX_DATA & 0xFF;
+		data[5] = PROTO_MAX_DATA >> 8;
+		data[6] = 0;
+		reply(f, PROTO_OK, data, 7);
+		return;
+
+	case PROTO_WRITE:
+		if (f->len < 3) {
+			reply(f, PROTO_ERR_LEN, NULL, 0);
+			return;
+		}
+		adr = p[1] | p[2] << 8;
+		n = f->len - 3;
+		if (p[0] >= MAX_BANKS || adr + n > RAM_SIZE) {
+			reply(f, PROTO_ERR_ARG, NULL, 0);
+			return;
+		}
+		memcpy(&ram[p[0]][adr], p + 3, n);
+		reply(f, PROTO_OK, NULL, 0);
+		return;
+
+	case PROTO_READ:
+		if (f->len != 5) {
+			reply(f, PROTO_ERR_LEN, NULL, 0);
+			return;
+		}
+		adr = p[1] | p[2] << 8;
+		n = p[3] | p[4] << 8;
+		if (p[0] >= MAX_BANKS || n > PROTO_MAX_DATA || adr + n > RAM_SIZE) {
+			reply(f, PROTO_ERR_ARG, NULL, 0);
+			return;
+		}
+		reply(f, PROTO_OK, &ram[p[0]][adr], n);
+		return;
+
+	case PROTO_BANK:
+	case PROTO_RUN:
+	case PROTO_RESET:
+		if (f->len != (f->cmd == PROTO_RESET ? 0 : 1)) {
+			reply(f, PROTO_ERR_LEN, NULL, 0);
+			return;
+		}
+		if (f->len && p[0] >= MAX_BANKS) {
+			reply(f, PROTO_ERR_ARG, NULL, 0);
+			return;
+		}
+		if (f->len)
+			cur_bank = p[0];
+		reply(f, PROTO_OK, NULL, 0);
+		return;
+
+	default:
+		reply(f, PROTO_ERR_CMD, NULL, 0);
+		return;
+	}
+}
+
+static void text(void) {
+
+	while (fifo_available()) {
+
+		size_t used;
+		int r = proto_line_feed(&line, fifo + fifo_tail, 1, &used);
+
+		fifo_tail += used;
+
+		if (r < 0) {
+			send_all("ERR LINE\r\n", 10);
+			return;
+		}
+
+		if (r > 0) {
+			char out[PROTO_LINE_MAX + 8];
+			int n = snprintf(out, sizeof(out), "TEXT %s\r\n", line.text);
+			send_all(out, n);
+			return;
+		}
+
+		if (!used)
+			return;
+	}
+}
+
+// host_rx_task()
+static void rx_task(void) {
+
+	static uint8_t chunk[64];
+
+	while (fifo_available()) {
+
+		uint8_t c = fifo[fifo_tail];
+
+		if (proto_idle(&parser) && (c != PROTO_SOF || (line.len && !line.done))) {
+			text();
+			continue;
+		}
+
+		size_t n = proto_wanted(&parser);
+		if (n > sizeof(chunk))
+			n = sizeof(chunk);
+
+		n = fifo_read(chunk, n);
+
+		size_t used;
+		int r = proto_feed(&parser, chunk, n, &used);
+
+		if (used != n) {
+			fprintf(stderr, "proto_feed left %zu bytes\n", n - used);
+			exit(1);
+		}
+
+		if (r > 0)
+			frame(&parser.frame);
+		else if (r < 0)
+			reply(&parser.frame, -r, NULL, 0);
+	}
+
+	fifo_head = fifo_tail = 0;
+}
+
+int main(void) {
+
+	fd = posix_openpt(O_RDWR | O_NOCTTY);
+	if (fd < 0 || grantpt(fd) || unlockpt(fd)) {
+		perror("pty");
+		return 1;
+	}
+
+	// held open so the master doesn't see EIO between host sessions
+	const char *name = ptsname(fd);
+	int slave = open(name, O_RDWR | O_NOCTTY);
+	struct termios tio;
+	if (slave < 0 || tcgetattr(slave, &tio)) {
+		perror(name);
+		return 1;
+	}
+	cfmakeraw(&tio);
+	tcsetattr(slave, TCSANOW, &tio);
+
+	proto_reset(&parser);
+	proto_line_reset(&line);
+
+	printf("%s\n", name);
+	fflush(stdout);
+
+	for (;;) {
+
+		ssize_t n = read(fd, fifo + fifo_head, sizeof(fifo) - fifo_head);
+
+		if (n < 0) {
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			perror("read");
+			return 1;
+		}
+
+		fifo_head += n;
+		rx_task();
+	}
+}
@@ -0,0 +1,18 @@
+#ifndef _DISKIO_DEFINED
+#define _DISKIO_DEFINED
+
+// Host stand-in for the FatFS disk layer, see ff.h
+
+#include "ff.h"
+
+typedef BYTE DSTATUS;
+
+typedef enum { RES_OK = 0, RES_ERROR, RES_WRPRT, RES_NOTRDY, RES_PARERR } DRESULT;
+
+#define STA_NOINIT 0x01
+
+DSTATUS disk_initialize(BYTE pdrv);
+DSTATUS disk_status(BYTE pdrv);
+DRESULT disk_read(BYTE pdrv, BYTE *buff, LBA_t sector, UINT count);
+
+#endif
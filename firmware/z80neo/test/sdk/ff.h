@@ -0,0 +1,93 @@
+#ifndef FF_DEFINED
+#define FF_DEFINED
+
+// Host stand-in for FatFS (R0.15 names and layout), only what storage.c uses.
+// The functions are up to the test that links it.
+
+#include <stdint.h>
+
+typedef unsigned int UINT;
+typedef unsigned char BYTE;
+typedef uint16_t WORD;
+typedef uint32_t DWORD;
+typedef char TCHAR;
+typedef DWORD FSIZE_t;
+typedef DWORD LBA_t;
+
+#define FF_LFN_BUF 255
+#define FF_SFN_BUF 12
+#define FF_MIN_SS 512
+
+typedef struct {
+	BYTE pdrv;
+	WORD csize;
+	LBA_t database;
+} FATFS;
+
+typedef struct {
+	FATFS *fs;
+	DWORD sclust;
+	FSIZE_t objsize;
+} FFOBJID;
+
+typedef struct {
+	FFOBJID obj;
+	FSIZE_t fptr;
+	DWORD clust;
+} FIL;
+
+typedef struct {
+	FFOBJID obj;
+	DWORD dptr;
+	const TCHAR *pat;
+} DIR;
+
+typedef struct {
+	FSIZE_t fsize;
+	WORD fdate;
+	WORD ftime;
+	BYTE fattrib;
+	TCHAR altname[FF_SFN_BUF + 1];
+	TCHAR fname[FF_LFN_BUF + 1];
+} FILINFO;
+
+typedef enum {
+	FR_OK = 0,
+	FR_DISK_ERR,
+	FR_INT_ERR,
+	FR_NOT_READY,
+	FR_NO_FILE,
+	FR_NO_PATH,
+	FR_INVALID_NAME,
+	FR_DENIED,
+	FR_EXIST,
+	FR_INVALID_OBJECT,
+	FR_WRITE_PROTECTED,
+	FR_INVALID_DRIVE,
+	FR_NOT_ENABLED,
+	FR_NO_FILESYSTEM,
+	FR_MKFS_ABORTED,
+	FR_TIMEOUT,
+	FR_LOCKED,
+	FR_NOT_ENOUGH_CORE,
+	FR_TOO_MANY_OPEN_FILES,
+	FR_INVALID_PARAMETER
+} FRESULT;
+
+FRESULT f_open(FIL *fp, const TCHAR *path, BYTE mode);
+FRESULT f_read(FIL *fp, void *buff, UINT btr, UINT *br);
+FRESULT f_lseek(FIL *fp, FSIZE_t ofs);
+FRESULT f_closedir(DIR *dp);
+FRESULT f_findfirst(DIR *dp, FILINFO *fno, const TCHAR *path, const TCHAR *pattern);
+FRESULT f_findnext(DIR *dp, FILINFO *fno);
+FRESULT f_mount(FATFS *fs, const TCHAR *path, BYTE opt);
+FRESULT f_getcwd(TCHAR *buff, UINT len);
+
+#define f_unmount(path) f_mount(0, path, 0)
+#define f_size(fp) ((fp)->obj.objsize)
+
+#define FA_READ 0x01
+
+#define AM_DIR 0x10
+
+#endif
@@ -0,0 +1,133 @@
+#ifndef _HARDWARE_DMA_H
+#define _HARDWARE_DMA_H
+
+// Host stand-in for the SDK's DMA, one channel that copies byte wide with the
+// sniffer modelled after the RP2350 datasheet: the accumulator shifts MSB
+// first, CRC32R feeds each byte bit reversed, and with output reverse set the
+// accumulator reads back bit reversed. Build with DMA_HOST_CHANNELS=0 for
+// a chip with no channel left.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "pico/types.h"
+
+#ifndef DMA_HOST_CHANNELS
+#define DMA_HOST_CHANNELS 1
+#endif
+
+#define DMA_SNIFF_CTRL_CALC_VALUE_CRC32 0x0
+#define DMA_SNIFF_CTRL_CALC_VALUE_CRC32R 0x1
+#define DMA_SNIFF_CTRL_CALC_VALUE_CRC16 0x2
+
+enum dma_channel_transfer_size { DMA_SIZE_8 = 0, DMA_SIZE_16 = 1, DMA_SIZE_32 = 2 };
+
+typedef struct {
+	bool read_increment;
+	bool write_increment;
+	bool sniff;
+	enum dma_channel_transfer_size size;
+} dma_channel_config;
+
+static struct {
+	bool claimed;
+	bool enabled;
+	int channel;
+	uint32_t calc;
+	bool out_rev;
+	uint32_t acc;
+} dma_host;
+
+static inline int dma_claim_unused_channel(bool required) {
+	(void)required;
+	if (dma_host.claimed || !DMA_HOST_CHANNELS)
+		return -1;
+	dma_host.claimed = true;
+	return 0;
+}
+
+static inline dma_channel_config dma_channel_get_default_config(uint channel) {
+	(void)channel;
+	dma_channel_config c = {true, false, false, DMA_SIZE_32};
+	return c;
+}
+
+static inline void channel_config_set_transfer_data_size(dma_channel_config *c,
+														 enum dma_channel_transfer_size size) {
+	c->size = size;
+}
+static inline void channel_config_set_read_increment(dma_channel_config *c, bool incr) {
+	c->read_increment = incr;
+}
+static inline void channel_config_set_write_increment(dma_channel_config *c, bool incr) {
+	c->write_increment = incr;
+}
+static inline void channel_config_set_sniff_enable(dma_channel_config *c, bool sniff) {
+	c->sniff = sniff;
+}
+
+static inline void dma_sniffer_enable(uint channel, uint mode, bool force_channel_enable) {
+	(void)force_channel_enable;
+	dma_host.enabled = true;
+	dma_host.channel = channel;
+	dma_host.calc = mode;
+}
+static inline void dma_sniffer_set_output_reverse_enabled(bool enable) { dma_host.out_rev = enable; }
+static inline void dma_sniffer_set_data_accumulator(uint32_t seed) { dma_host.acc = seed; }
+static inline void dma_sniffer_disable(void) { dma_host.enabled = false; }
+
+static inline uint32_t dma_host_rev32(uint32_t v) {
+	uint32_t r = 0;
+	for (int i = 0; i < 32; i++, v >>= 1)
+		r = (r << 1) | (v & 1);
+	return r;
+}
+
+static inline uint32_t dma_sniffer_get_data_accumulator(void) {
+	return dma_host.out_rev ? dma_host_rev32(dma_host.acc) : dma_host.acc;
+}
+
+static inline void dma_host_sniff(uint8_t b) {
+
+	if (dma_host.calc == DMA_SNIFF_CTRL_CALC_VALUE_CRC16) {
+		uint32_t acc = dma_host.acc ^ (uint32_t)b << 8;
+		for (int i = 0; i < 8; i++)
+			acc = acc & 0x8000 ? (acc << 1) ^ 0x1021 : acc << 1;
+		dma_host.acc = acc & 0xffff;
+		return;
+	}
+
+	if (dma_host.calc == DMA_SNIFF_CTRL_CALC_VALUE_CRC32R)
+		b = dma_host_rev32(b) >> 24;
+
+	uint32_t acc = dma_host.acc ^ (uint32_t)b << 24;
+	for (int i = 0; i < 8; i++)
+		acc = acc & 0x80000000 ? (acc << 1) ^ 0x04c11db7 : acc << 1;
+	dma_host.acc = acc;
+}
+
+static inline void dma_channel_configure(uint channel, const dma_channel_config *c,
+										 volatile void *write_addr, const volatile void *read_addr,
+										 uint transfer_count, bool trigger) {
+
+	volatile uint8_t *w = write_addr;
+	const volatile uint8_t *r = read_addr;
+
+	if (!trigger)
+		return;
+
+	for (uint i = 0; i < transfer_count; i++) {
+		uint8_t b = *r;
+		*w = b;
+		if (c->sniff && dma_host.enabled && dma_host.channel == (int)channel)
+			dma_host_sniff(b);
+		if (c->read_increment)
+			r++;
+		if (c->write_increment)
+			w++;
+	}
+}
+
+static inline void dma_channel_wait_for_finish_blocking(uint channel) { (void)channel; }
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef _PICO_STDLIB_H
+#define _PICO_STDLIB_H
+
+// Host stand-in for the Pico SDK, only what the modules under test use
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "pico/types.h"
+
+static inline uint32_t time_us_32(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000u + ts.tv_nsec / 1000;
+}
+
+static inline void __dmb(void) { __sync_synchronize(); }
+
+#endif
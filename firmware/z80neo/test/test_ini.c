@@ -0,0 +1,216 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ini.h"
+
+//
+// ini.c on the host
+//
+
+#define MAX_LINES 16
+
+typedef struct {
+	int count;
+	const char *key[MAX_LINES];
+	const char *value[MAX_LINES];
+	int line[MAX_LINES];
+} lines;
+
+static int failed = 0;
+
+#define CHECK(cond)                                                   \
+	do {                                                              \
+		if (!(cond)) {                                                \
+			printf("%s:%d: %s: %s\n", __FILE__, __LINE__, name, #cond); \
+			failed++;                                                 \
+		}                                                             \
+	} while (0)
+
+static void collect(const char *key, const char *value, int line, void *user) {
+
+	lines *l = user;
+
+	if (l->count < MAX_LINES) {
+		l->key[l->count] = key;
+		l->value[l->count] = value;
+		l->line[l->count] = line;
+	}
+
+	l->count++;
+}
+
+// Parses a copy of text in a buffer that is exactly long enough, plus the
+// terminator and a guard byte that must survive
+static int parse(const char *text, size_t len, lines *l, char **buf) {
+
+	*buf = malloc(len + 2);
+	memcpy(*buf, text, len);
+	(*buf)[len] = 'X';
+	(*buf)[len + 1] = 'G';
+
+	memset(l, 0, sizeof(*l));
+
+	return ini_parse(*buf, len, collect, l);
+}
+
+static int same(const char *a, const char *b) {
+	return a && b ? strcmp(a, b) == 0 : a == b;
+}
+
+static void test_key_value(void) {
+
+	const char *name = "key=value";
+	const char text[] = "machine = Z80NEO\nclock=50\n  devices =  serial, int  \nempty=\n=novalue\n";
+	lines l;
+	char *buf;
+
+	int n = parse(text, sizeof(text) - 1, &l, &buf);
+
+	CHECK(n == 5 && l.count == 5);
+	CHECK(same(l.key[0], "machine") && same(l.value[0], "Z80NEO") && l.line[0] == 1);
+	CHECK(same(l.key[1], "clock") && same(l.value[1], "50") && l.line[1] == 2);
+	CHECK(same(l.key[2], "devices") && same(l.value[2], "serial, int"));
+	CHECK(same(l.key[3], "empty") && same(l.value[3], ""));
+	CHECK(same(l.key[4], "") && same(l.value[4], "novalue"));
+	CHECK(buf[sizeof(text)] == 'G');
+
+	// only the first '=' splits
+	free(buf);
+	const char eq[] = "bank0=A=B.HEX";
+	n = parse(eq, sizeof(eq) - 1, &l, &buf);
+	CHECK(n == 1 && same(l.key[0], "bank0") && same(l.value[0], "A=B.HEX"));
+
+	free(buf);
+}
+
+static void test_legacy(void) {
+
+	const char *name = "positional";
+	const char text[] = "Z80NEO\n9a0\n7d0\n600\n480\n300\n150\nLEDS.HEX\nbank1=ECHO.HEX\n0\n";
+	lines l;
+	char *buf;
+
+	int n = parse(text, sizeof(text) - 1, &l, &buf);
+
+	// keyless lines come in file order for the caller's positional table,
+	// keyed ones mixed in don't take a position
+	CHECK(n == 10);
+	CHECK(l.key[0] == NULL && same(l.value[0], "Z80NEO"));
+	CHECK(l.key[6] == NULL && same(l.value[6], "150"));
+	CHECK(l.key[7] == NULL && same(l.value[7], "LEDS.HEX") && l.line[7] == 8);
+	CHECK(same(l.key[8], "bank1") && same(l.value[8], "ECHO.HEX"));
+	CHECK(l.key[9] == NULL && same(l.value[9], "0") && l.line[9] == 10);
+
+	free(buf);
+}
+
+static void test_comments(void) {
+
+	const char *name = "comments";
+	const char text[] = "; comment\n# comment=1\n[z80neo]\n   ; indented\n\n   \nclock=50 ; not a comment here\n";
+	lines l;
+	char *buf;
+
+	int n = parse(text, sizeof(text) - 1, &l, &buf);
+
+	CHECK(n == 1);
+	CHECK(same(l.key[0], "clock") && same(l.value[0], "50 ; not a comment here"));
+	CHECK(l.line[0] == 7);
+
+	free(buf);
+}
+
+static void test_crlf(void) {
+
+	const char *name = "crlf";
+	const char text[] = "machine=Z80NEO\r\n\r\nclock=50\r\nLEDS.HEX\r\nverbose=1";
+	lines l;
+	char *buf;
+
+	int n = parse(text, sizeof(text) - 1, &l, &buf);
+
+	// "\r\n" is one line, no '\r' left in a value, the last line needs no end
+	CHECK(n == 4);
+	CHECK(same(l.key[0], "machine") && same(l.value[0], "Z80NEO") && l.line[0] == 1);
+	CHECK(same(l.key[1], "clock") && same(l.value[1], "50") && l.line[1] == 3);
+	CHECK(l.key[2] == NULL && same(l.value[2], "LEDS.HEX") && l.line[2] == 4);
+	CHECK(same(l.key[3], "verbose") && same(l.value[3], "1") && l.line[3] == 5);
+	CHECK(buf[sizeof(text)] == 'G');
+
+	free(buf);
+
+	// old Mac endings
+	const char cr[] = "a=1\rb=2\r";
+	n = parse(cr, sizeof(cr) - 1, &l, &buf);
+	CHECK(n == 2 && same(l.value[0], "1") && same(l.key[1], "b") && l.line[1] == 2);
+
+	free(buf);
+}
+
+static void test_long_line(void) {
+
+	const char *name = "long line";
+	size_t long_len = 3000;
+	size_t len = long_len + 32;
+	char *text = malloc(len);
+	lines l;
+	char *buf;
+
+	size_t n = 0;
+	n += sprintf(text + n, "machine=");
+	memset(text + n, 'x', long_len);
+	n += long_len;
+	n += sprintf(text + n, "\nclock=50\n");
+
+	int count = parse(text, n, &l, &buf);
+
+	// no line limit, and the next line is still found
+	CHECK(count == 2);
+	CHECK(same(l.key[0], "machine") && strlen(l.value[0]) == long_len);
+	CHECK(same(l.key[1], "clock") && same(l.value[1], "50") && l.line[1] == 2);
+	CHECK(buf[n + 1] == 'G');
+
+	free(buf);
+
+	// a file cut off mid line, like one over INI_MAX_SIZE
+	count = parse(text, 8 + 100, &l, &buf);
+	CHECK(count == 1 && strlen(l.value[0]) == 100);
+	CHECK(buf[8 + 100 + 1] == 'G');
+
+	free(buf);
+
+	// a stray nul ends the line like a newline
+	const char nul[] = "a=1\0junk\nb=2\n";
+	count = parse(nul, sizeof(nul) - 1, &l, &buf);
+	CHECK(same(l.key[0], "a") && same(l.value[0], "1"));
+	CHECK(same(l.key[l.count - 1], "b") && same(l.value[l.count - 1], "2"));
+
+	free(buf);
+	free(text);
+}
+
+static void test_key_is(void) {
+
+	const char *name = "ini_key_is";
+
+	CHECK(ini_key_is("Clock", "clock"));
+	CHECK(ini_key_is("ADC_OK", "adc_ok"));
+	CHECK(!ini_key_is("clocks", "clock"));
+	CHECK(!ini_key_is("cloc", "clock"));
+	CHECK(!ini_key_is("", "clock"));
+}
+
+int main(void) {
+
+	test_key_value();
+	test_legacy();
+	test_comments();
+	test_crlf();
+	test_long_line();
+	test_key_is();
+
+	printf("ini: %s\n", failed ? "FAILED" : "ok");
+
+	return failed != 0;
+}
@@ -0,0 +1,224 @@
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+#include "diskio.h"
+#include "ff.h"
+#include "storage.h"
+
+//
+// storage.c on the host, the directory index against a fake FatFS
+//
+
+static int failed = 0;
+
+#define CHECK(cond)                                                   \
+	do {                                                              \
+		if (!(cond)) {                                                \
+			printf("%s:%d: %s: %s\n", __FILE__, __LINE__, name, #cond); \
+			failed++;                                                 \
+		}                                                             \
+	} while (0)
+
+// the pattern the firmware browses with, main.c FILE_EXT
+#define FILE_EXT "*.HEX|*.BIN|*.ZX0|*.LZ4"
+
+typedef struct {
+	const char *name;
+	const char *alt;
+	BYTE attr;
+} fake_file;
+
+static const fake_file files[] = {
+	{"LEDS.HEX", "LEDS.HEX", 0},
+	{"ECHO.BIN", "ECHO.BIN", 0},
+	{"BASIC.ZX0", "BASIC.ZX0", 0},
+	{"A_VERY_LONG_PROGRAM_NAME.LZ4", "A_VERY~1.LZ4", 0},
+	{"Z80NEO.INI", "Z80NEO.INI", 0},
+	{"GAMES.BIN", "GAMES.BIN", AM_DIR},
+	{"CPM.BIN", "CPM.BIN", 0},
+};
+
+#define NFILES (sizeof(files) / sizeof(files[0]))
+
+static int findfirst_calls = 0;
+static int mount_calls = 0;
+
+static int match(const char *name, const char *pattern) {
+
+	// "*.EXT" is all the firmware asks for
+	size_t n = strlen(name), p = strlen(pattern) - 1;
+
+	return pattern[0] == '*' && n >= p && strcasecmp(name + n - p, pattern + 1) == 0;
+}
+
+static FRESULT next(DIR *dp, FILINFO *fno) {
+
+	while (dp->dptr < NFILES && !match(files[dp->dptr].name, dp->pat))
+		dp->dptr++;
+
+	if (dp->dptr == NFILES) {
+		fno->fname[0] = 0;
+		return FR_OK;
+	}
+
+	const fake_file *f = &files[dp->dptr++];
+	strcpy(fno->fname, f->name);
+	strcpy(fno->altname, f->alt);
+	fno->fattrib = f->attr;
+	fno->fsize = 100 + dp->dptr;
+
+	return FR_OK;
+}
+
+FRESULT f_findfirst(DIR *dp, FILINFO *fno, const TCHAR *path, const TCHAR *pattern) {
+	(void)path;
+	findfirst_calls++;
+	dp->dptr = 0;
+	dp->pat = pattern;
+	return next(dp, fno);
+}
+
+FRESULT f_findnext(DIR *dp, FILINFO *fno) { return next(dp, fno); }
+FRESULT f_closedir(DIR *dp) {
+	(void)dp;
+	return FR_OK;
+}
+
+FRESULT f_mount(FATFS *fs, const TCHAR *path, BYTE opt) {
+	(void)path;
+	(void)opt;
+	if (fs)
+		mount_calls++;
+	return FR_OK;
+}
+
+FRESULT f_getcwd(TCHAR *buff, UINT len) {
+	snprintf(buff, len, "/");
+	return FR_OK;
+}
+
+// not used by the index
+FRESULT f_open(FIL *fp, const TCHAR *path, BYTE mode) {
+	(void)fp, (void)path, (void)mode;
+	return FR_NO_FILE;
+}
+FRESULT f_read(FIL *fp, void *buff, UINT btr, UINT *br) {
+	(void)fp, (void)buff, (void)btr;
+	*br = 0;
+	return FR_OK;
+}
+FRESULT f_lseek(FIL *fp, FSIZE_t ofs) {
+	fp->fptr = ofs;
+	return FR_OK;
+}
+
+static DSTATUS status = 0;
+
+DSTATUS disk_initialize(BYTE pdrv) {
+	(void)pdrv;
+	return 0;
+}
+DSTATUS disk_status(BYTE pdrv) {
+	(void)pdrv;
+	return status;
+}
+DRESULT disk_read(BYTE pdrv, BYTE *buff, LBA_t sector, UINT count) {
+	(void)pdrv, (void)buff, (void)sector, (void)count;
+	return RES_ERROR;
+}
+
+//
+//
+//
+
+static void test_index(void) {
+
+	const char *name = "index";
+
+	CHECK(storage_mount() == FR_OK);
+
+	// the directory and INI aren't in it, sorted by name, long names as 8.3
+	int n = storage_index(FILE_EXT);
+	CHECK(n == 5);
+	CHECK(findfirst_calls == 4);
+	CHECK(strcmp(storage_index_entry(1)->name, "A_VERY~1.LZ4") == 0);
+	CHECK(strcmp(storage_index_entry(2)->name, "BASIC.ZX0") == 0);
+	CHECK(strcmp(storage_index_entry(5)->name, "LEDS.HEX") == 0);
+	CHECK(storage_index_entry(6) == NULL);
+}
+
+static void test_cached(void) {
+
+	const char *name = "cached";
+
+	int calls = findfirst_calls;
+
+	// a repeat call is served from the index
+	CHECK(storage_index(FILE_EXT) == 5);
+	CHECK(storage_index(FILE_EXT) == 5);
+	CHECK(findfirst_calls == calls);
+
+	// and still is with the card checked again in between
+	CHECK(storage_mount() == FR_OK);
+	CHECK(storage_index(FILE_EXT) == 5);
+	CHECK(findfirst_calls == calls);
+}
+
+static void test_rescan(void) {
+
+	const char *name = "rescan";
+
+	int calls = findfirst_calls;
+
+	CHECK(storage_index("*.HEX") == 1);
+	CHECK(findfirst_calls == calls + 1);
+
+	CHECK(storage_index(FILE_EXT) == 5);
+	CHECK(findfirst_calls == calls + 5);
+
+	storage_index_invalidate();
+	CHECK(storage_index(FILE_EXT) == 5);
+	CHECK(findfirst_calls == calls + 9);
+
+	// a card swap
+	status = STA_NOINIT;
+	CHECK(storage_mount() == FR_OK);
+	status = 0;
+	CHECK(storage_index(FILE_EXT) == 5);
+	CHECK(findfirst_calls == calls + 13);
+	CHECK(storage_index(FILE_EXT) == 5);
+	CHECK(findfirst_calls == calls + 13);
+}
+
+static void test_long_pattern(void) {
+
+	const char *name = "long pattern";
+
+	char pattern[DIR_PATTERN_LEN + 16] = "*.HEX";
+
+	while (strlen(pattern) < DIR_PATTERN_LEN)
+		strcat(pattern, "|*.BIN");
+
+	// too long to keep, still indexed, just not served from the index
+	int calls = findfirst_calls;
+	int n = storage_index(pattern);
+	CHECK(n >= 3 && storage_index_entry(1) != NULL);
+	int scans = findfirst_calls - calls;
+	CHECK(storage_index(pattern) == n);
+	CHECK(findfirst_calls == calls + 2 * scans);
+
+	CHECK(storage_index(FILE_EXT) == 5);
+}
+
+int main(void) {
+
+	test_index();
+	test_cached();
+	test_rescan();
+	test_long_pattern();
+
+	printf("storage: %s\n", failed ? "FAILED" : "ok");
+
+	return failed != 0;
+}
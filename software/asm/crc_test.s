@@ -0,0 +1,115 @@
+;-- Vectores de prueba del motor de CRC
+;--
+;-- Needs devices=serial,crc. software/tools/crc_vectors.py writes a
+;-- vector at VECTOR (length word, then the data) and runs this. For
+;-- CRC-16, CRC-32 and Fletcher-16 it prints one line on the serial port,
+;-- the result over the block and the same bytes through the data port:
+;--   bbbbbbbb ssssssss
+
+;---- PUERTOS
+SERIAL_DATA:	equ 0x80
+
+;---- Motor de CRC, en memoria (z80_crc.h)
+CRC_ADR:		equ 0x00C4
+CRC_BANK:		equ 0x00C6
+CRC_LEN:		equ 0x00C7
+CRC_CMD:		equ 0x00C9
+CRC_DATA:		equ 0x00CA
+CRC_RESULT:		equ 0x00CB
+
+CRC_BLOCK:		equ 0x40
+CRC_RESTART:	equ 0x80
+
+VECTOR:			equ 0x1000
+
+;--- Comienzo del programa
+org 0x0000
+
+  jp	MAIN
+
+;-- The device registers live at 0x0088-0x00CE, code starts above them
+  ds	0x0100 - ASMPC
+
+MAIN:
+  ld	sp,		topOfStack
+
+  ld	C,		0
+ALGO_LOOP:
+
+  ;-- Bloque
+  ld	HL,		VECTOR + 2
+  ld	(CRC_ADR), HL
+  ld	HL,		(VECTOR)
+  ld	(CRC_LEN), HL
+  ld	A,		C
+  or	CRC_RESTART + CRC_BLOCK
+  ld	(CRC_CMD), A
+  call	PRINT_RESULT
+
+  ld	A,		' '
+  out	(SERIAL_DATA), A
+
+  ;-- Byte a byte
+  ld	A,		C
+  or	CRC_RESTART
+  ld	(CRC_CMD), A
+  ld	HL,		VECTOR + 2
+  ld	DE,		(VECTOR)
+STREAM:
+  ld	A,		D
+  or	E
+  jr	z,		STREAM_END
+  ld	A,		(HL)
+  ld	(CRC_DATA), A
+  inc	HL
+  dec	DE
+  jr	STREAM
+STREAM_END:
+  call	PRINT_RESULT
+
+  ld	A,		13
+  out	(SERIAL_DATA), A
+  ld	A,		10
+  out	(SERIAL_DATA), A
+
+  inc	C
+  ld	A,		C
+  cp	3
+  jr	nz,		ALGO_LOOP
+
+  halt
+
+
+;-----------------------------------------------------------
+;-- Resultado en hexadecimal, 8 digitos
+;-----------------------------------------------------------
+PRINT_RESULT:
+  ld	HL,		CRC_RESULT + 3
+  ld	B,		4
+PR_BYTE:
+  ld	A,		(HL)
+  call	PRINT_HEX
+  dec	HL
+  djnz	PR_BYTE
+  ret
+
+PRINT_HEX:
+  push	AF
+  rrca
+  rrca
+  rrca
+  rrca
+  call	PRINT_NIBBLE
+  pop	AF
+PRINT_NIBBLE:
+  and	0x0F
+  add	A,		'0'
+  cp	'9' + 1
+  jr	c,		PN_OUT
+  add	A,		'A' - '9' - 1
+PN_OUT:
+  out	(SERIAL_DATA), A
+  ret
+
+  ds 64
+topOfStack:
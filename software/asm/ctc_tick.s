@@ -0,0 +1,70 @@
+;-- Un punto por segundo con el CTC (IM 2)
+;--
+;-- Needs devices=serial,int,ctc in Z80NEO.INI, ctc_clock=1000000.
+;-- Channel 0 is a timer, 16 x 250 clocks = 4 ms, channel 1 counts 250
+;-- of them and interrupts once a second.
+
+;---- PUERTOS
+SERIAL_DATA:	equ 0x80
+
+;---- CTC, en memoria (z80_ctc.h, ctc_base)
+CTC0:			equ 0x0090
+CTC1:			equ 0x0091
+
+;--- Comienzo del programa
+org 0x0000
+
+MAIN:
+  ld	sp,		topOfStack
+
+  ld	A,		VECTORS / 256
+  ld	I,		A
+  im	2
+
+  ;-- Vector del CTC, el canal va en los bits 2-1
+  ld	A,		0x10
+  ld	(CTC0), A
+
+  ;-- Canal 0: timer, prescaler 16, sigue la constante, reset
+  ld	A,		0x07
+  ld	(CTC0), A
+  ld	A,		250
+  ld	(CTC0), A
+
+  ;-- Canal 1: contador con interrupcion, sigue la constante, reset
+  ld	A,		0xC7
+  ld	(CTC1), A
+  ld	A,		250
+  ld	(CTC1), A
+
+  ei
+
+LOOP:
+  halt
+  jr LOOP
+
+
+;-- Canal 1 a cero, un punto al PC
+ISR_CTC1:
+  push	AF
+
+  ld	A,		'.'
+  out	(SERIAL_DATA), A
+
+  pop	AF
+  ei
+  reti
+
+
+;--- Vectores del CTC, canales 0-3
+org 0x0110
+
+VECTORS:	equ 0x0100
+
+  DW 0
+  DW ISR_CTC1
+  DW 0
+  DW 0
+
+  ds 64
+topOfStack:
@@ -0,0 +1,72 @@
+;-- LDIR contra el acelerador de copia
+;--
+;-- Needs devices=serial,dma. Sends a marker before and after each
+;-- copy, software/tools/z80bench.py times them on the PC:
+;--   L ... l   LDIR of BENCH_LEN bytes
+;--   D ... d   the same copy with DMA_LDIR
+;--   + or -    DMA_MEMCMP of both copies, equal or not
+
+;---- PUERTOS
+SERIAL_DATA:	equ 0x80
+
+BENCH_LEN:		equ 256
+BENCH_SRC:		equ 0x1000
+BENCH_LDIR:		equ 0x2000
+BENCH_DMA:		equ 0x3000
+
+;--- Comienzo del programa
+org 0x0000
+
+  jp	MAIN
+
+;-- The device registers live at 0x0088-0x00AB, code starts above them
+  ds	0x0100 - ASMPC
+
+INCLUDE "dma.inc"
+
+MAIN:
+  ld	sp,		topOfStack
+
+  ;-- Datos de prueba
+  ld	HL,		BENCH_SRC
+  ld	B,		0
+FILL_SRC:
+  ld	(HL),	B
+  inc	HL
+  djnz	FILL_SRC
+
+  ;-- LDIR
+  ld	A,		'L'
+  out	(SERIAL_DATA), A
+  ld	HL,		BENCH_SRC
+  ld	DE,		BENCH_LDIR
+  ld	BC,		BENCH_LEN
+  ldir
+  ld	A,		'l'
+  out	(SERIAL_DATA), A
+
+  ;-- Acelerador
+  ld	A,		'D'
+  out	(SERIAL_DATA), A
+  ld	HL,		BENCH_SRC
+  ld	DE,		BENCH_DMA
+  ld	BC,		BENCH_LEN
+  call	DMA_LDIR
+  ld	A,		'd'
+  out	(SERIAL_DATA), A
+
+  ;-- Las dos copias deben ser iguales
+  ld	HL,		BENCH_LDIR
+  ld	DE,		BENCH_DMA
+  ld	BC,		BENCH_LEN
+  call	DMA_MEMCMP
+  ld	A,		'+'
+  jr	z,		RESULT
+  ld	A,		'-'
+RESULT:
+  out	(SERIAL_DATA), A
+
+  halt
+
+  ds 64
+topOfStack:
@@ -0,0 +1,74 @@
+;-- Eco del puerto serie por interrupciones (IM 2)
+;--
+;-- Needs devices=serial,int in Z80NEO.INI and the /INT and /M1 lines
+;-- wired. The Z80 sleeps in HALT and every byte that arrives raises
+;-- INT_RX, the handler sends it back.
+
+;---- PUERTOS
+SERIAL_DATA:	equ 0x80
+
+;---- Controlador de interrupciones, en memoria (z80_int.h)
+INT_ENABLE:		equ 0x0088
+INT_VECTOR:		equ 0x0089
+
+INT_RX:			equ 0x01
+
+;--- Comienzo del programa
+org 0x0000
+
+MAIN:
+  ld	sp,		topOfStack
+
+  ;-- Tabla de vectores en 0x0100, fuente n en 0x0100 + 2n
+  ld	A,		VECTORS / 256
+  ld	I,		A
+  im	2
+
+  xor	A
+  ld	(INT_VECTOR), A
+
+  ld	A,		INT_RX
+  ld	(INT_ENABLE), A
+
+  ei
+
+;-- Bucle principal, todo pasa en la interrupcion
+LOOP:
+  halt
+  jr LOOP
+
+
+;-----------------------------------------------------------
+;-- INT_RX: hay un caracter esperando, se devuelve al PC.
+;-- Es de nivel, si quedan mas vuelve a entrar
+;-----------------------------------------------------------
+ISR_RX:
+  push	AF
+
+  ld	A,		(SERIAL_DATA)
+  out	(SERIAL_DATA), A
+
+  pop	AF
+  ei
+  reti
+
+ISR_NONE:
+  ei
+  reti
+
+
+;--- Tabla de vectores, 8 fuentes
+org 0x0100
+
+VECTORS:
+  DW ISR_RX
+  DW ISR_NONE
+  DW ISR_NONE
+  DW ISR_NONE
+  DW ISR_NONE
+  DW ISR_NONE
+  DW ISR_NONE
+  DW ISR_NONE
+
+  ds 64
+topOfStack:
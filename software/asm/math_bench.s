@@ -0,0 +1,93 @@
+;-- Multiplicacion por software contra el coprocesador
+;--
+;-- Needs devices=serial,math. Timed on the PC by software/tools/z80bench.py:
+;--   S ... s   BENCH_N 16 x 16 multiplies with shift and add
+;--   M ... m   the same with the coprocessor (_z80m_mul16)
+;--   + or -    the products agree or not
+
+;---- PUERTOS
+SERIAL_DATA:	equ 0x80
+
+BENCH_N:		equ 4
+BENCH_A:		equ 12345
+BENCH_B:		equ 4321
+
+;--- Comienzo del programa
+org 0x0000
+
+  jp	MAIN
+
+;-- The device registers live at 0x0088-0x00C0, code starts above them
+  ds	0x0100 - ASMPC
+
+INCLUDE "../z88dk/z80math.asm"
+
+MAIN:
+  ld	sp,		topOfStack
+
+  ;-- Software
+  ld	A,		'S'
+  out	(SERIAL_DATA), A
+  ld	B,		BENCH_N
+SOFT_LOOP:
+  push	BC
+  ld	DE,		BENCH_A
+  ld	BC,		BENCH_B
+  call	SOFT_MUL16
+  pop	BC
+  djnz	SOFT_LOOP
+  ld	(SOFT_RES), HL
+  ld	A,		's'
+  out	(SERIAL_DATA), A
+
+  ;-- Coprocesador
+  ld	A,		'M'
+  out	(SERIAL_DATA), A
+  ld	B,		BENCH_N
+MATH_LOOP:
+  push	BC
+  ld	HL,		BENCH_B
+  push	HL
+  ld	HL,		BENCH_A
+  push	HL
+  call	_z80m_mul16
+  pop	BC
+  djnz	MATH_LOOP
+  ld	A,		'm'
+  out	(SERIAL_DATA), A
+
+  ;-- Mismo resultado (16 bits bajos)
+  ld	DE,		(SOFT_RES)
+  or	A
+  sbc	HL,		DE
+  ld	A,		'+'
+  jr	z,		RESULT
+  ld	A,		'-'
+RESULT:
+  out	(SERIAL_DATA), A
+
+  halt
+
+
+;-----------------------------------------------------------
+;-- HL = DE * BC, 16 bits bajos, desplazamiento y suma
+;-----------------------------------------------------------
+SOFT_MUL16:
+  ld	HL,		0
+  ld	A,		16
+SOFT_BIT:
+  add	HL,		HL
+  sla	C
+  rl	B
+  jr	nc,		SOFT_NEXT
+  add	HL,		DE
+SOFT_NEXT:
+  dec	A
+  jr	nz,		SOFT_BIT
+  ret
+
+SOFT_RES:
+  DW 0
+
+  ds 64
+topOfStack:
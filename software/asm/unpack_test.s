@@ -0,0 +1,110 @@
+;-- Prueba del descompresor ZX0/LZ4
+;--
+;-- Needs devices=serial,unpack. software/tools/pack.py writes the packed
+;-- data at the start of bank PARAM_SRC, the parameters at PARAMS and runs
+;-- this. It unpacks into the start of bank PARAM_DST and prints one line on
+;-- the serial port, status, bytes unpacked and microseconds:
+;--   ss cccc tttttttt
+
+;---- PUERTOS
+SERIAL_DATA:	equ 0x80
+
+;---- Descompresor, en memoria (z80_unpack.h)
+UNPACK_SRC:		equ 0x00D0
+UNPACK_SRC_BANK: equ 0x00D2
+UNPACK_DST:		equ 0x00D3
+UNPACK_DST_BANK: equ 0x00D5
+UNPACK_FORMAT:	equ 0x00D6
+UNPACK_STATUS:	equ 0x00D6
+UNPACK_COUNT:	equ 0x00D7
+UNPACK_LEN:		equ 0x00D9
+UNPACK_TIME:	equ 0x00DB
+
+;---- Parametros: formato, banco origen, banco destino, longitud
+PARAMS:			equ 0x0F00
+PARAM_FORMAT:	equ PARAMS
+PARAM_SRC:		equ PARAMS + 1
+PARAM_DST:		equ PARAMS + 2
+PARAM_LEN:		equ PARAMS + 3
+
+;--- Comienzo del programa
+org 0x0000
+
+  jp	MAIN
+
+;-- The device registers live at 0x0088-0x00DE, code starts above them
+  ds	0x0100 - ASMPC
+
+MAIN:
+  ld	sp,		topOfStack
+
+  ld	HL,		0
+  ld	(UNPACK_SRC), HL
+  ld	(UNPACK_DST), HL
+  ld	A,		(PARAM_SRC)
+  ld	(UNPACK_SRC_BANK), A
+  ld	A,		(PARAM_DST)
+  ld	(UNPACK_DST_BANK), A
+  ld	HL,		(PARAM_LEN)
+  ld	(UNPACK_LEN), HL
+
+  ;-- Done by the time the write ends
+  ld	A,		(PARAM_FORMAT)
+  ld	(UNPACK_FORMAT), A
+
+  ld	A,		(UNPACK_STATUS)
+  call	PRINT_HEX
+  call	PRINT_SPACE
+
+  ld	HL,		UNPACK_COUNT + 1
+  ld	B,		2
+  call	PRINT_WORD
+  call	PRINT_SPACE
+
+  ld	HL,		UNPACK_TIME + 3
+  ld	B,		4
+  call	PRINT_WORD
+
+  ld	A,		13
+  out	(SERIAL_DATA), A
+  ld	A,		10
+  out	(SERIAL_DATA), A
+
+  halt
+
+
+;-----------------------------------------------------------
+;-- B bytes en hexadecimal desde (HL) hacia abajo
+;-----------------------------------------------------------
+PRINT_WORD:
+  ld	A,		(HL)
+  call	PRINT_HEX
+  dec	HL
+  djnz	PRINT_WORD
+  ret
+
+PRINT_SPACE:
+  ld	A,		' '
+  out	(SERIAL_DATA), A
+  ret
+
+PRINT_HEX:
+  push	AF
+  rrca
+  rrca
+  rrca
+  rrca
+  call	PRINT_NIBBLE
+  pop	AF
+PRINT_NIBBLE:
+  and	0x0F
+  add	A,		'0'
+  cp	'9' + 1
+  jr	c,		PN_OUT
+  add	A,		'A' - '9' - 1
+PN_OUT:
+  out	(SERIAL_DATA), A
+  ret
+
+  ds 64
+topOfStack:
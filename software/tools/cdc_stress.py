@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+#
+# CDC stress test and throughput benchmark for z80neo.
+#
+#   cdc_stress.py -p /dev/ttyACM1                      # CDC 1 only
+#   cdc_stress.py -p /dev/ttyACM1 -s /dev/ttyACM0      # plus the Z80 serial
+#
+# CDC 1: fills every bank with random data through the binary protocol
+# (WRITE, host to board), reads it all back (READ, board to host) and
+# compares. That is the USB path alone, the Z80 is not involved. It
+# overwrites every bank, the running one included.
+#
+# CDC 0: with an echo program running on the Z80 (software/asm/serial_echo.s)
+# streams a pattern to the serial port and checks what comes back. Both
+# directions go through the Z80, so the rate is bound by its clock.
+#
+# Run it with --rounds to soak the link, any mismatch or timeout fails it.
+
+import argparse
+import os
+import sys
+import time
+
+import serial
+
+from z80neo import Board
+
+
+def rate(n, secs):
+    return "%8.1f KB/s" % (n / 1024 / secs if secs else 0)
+
+
+def stress_cdc1(board, info):
+    size = info["bank_size"]
+    banks = info["banks"]
+    data = [os.urandom(size) for _ in range(banks)]
+
+    start = time.time()
+    for bank in range(banks):
+        board.write(bank, 0, data[bank])
+    up = time.time() - start
+
+    start = time.time()
+    back = [board.read(bank, 0, size) for bank in range(banks)]
+    down = time.time() - start
+
+    bad = [bank for bank in range(banks) if back[bank] != data[bank]]
+
+    print("CDC1 host->board %s  board->host %s  %d KB%s" % (
+        rate(size * banks, up), rate(size * banks, down), size * banks // 1024,
+        "  MISMATCH in banks %s" % bad if bad else ""))
+
+    return not bad
+
+
+def stress_cdc0(port, count):
+    ser = serial.Serial(port, timeout=2.0)
+    ser.reset_input_buffer()
+
+    pattern = bytes((i % 255) + 1 for i in range(count)) # no 0, the Z80 side skips it
+    got = b""
+
+    start = time.time()
+    for ofs in range(0, count, 64):
+        ser.write(pattern[ofs:ofs + 64])
+        got += ser.read(ser.in_waiting)
+    while len(got) < count:
+        chunk = ser.read(count - len(got))
+        if not chunk:
+            break
+        got += chunk
+    secs = time.time() - start
+
+    ok = got == pattern
+    print("CDC0 echo %s  %d/%d bytes%s" % (rate(len(got), secs), len(got), count,
+          "" if ok else "  MISMATCH"))
+
+    return ok
+
+
+def main():
+    ap = argparse.ArgumentParser(description="z80neo CDC stress test")
+    ap.add_argument("-p", "--port", required=True, help="CDC 1 (commands)")
+    ap.add_argument("-s", "--serial", help="CDC 0 (Z80 serial), needs an echo program")
+    ap.add_argument("-n", "--count", type=int, default=4096, help="bytes through the Z80")
+    ap.add_argument("-r", "--rounds", type=int, default=1)
+    args = ap.parse_args()
+
+    board = Board(args.port)
+    info = board.ping()
+
+    ok = True
+    for _ in range(args.rounds):
+        ok &= stress_cdc1(board, info)
+        if args.serial:
+            ok &= stress_cdc0(args.serial, args.count)
+
+    sys.exit(0 if ok else 1)
+
+
+if __name__ == "__main__":
+    main()
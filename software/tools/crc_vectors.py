@@ -0,0 +1,181 @@
+#!/usr/bin/env python3
+#
+# Test vectors for the CRC engine (firmware/z80neo/include/z80_crc.h).
+#
+#   crc_vectors.py                                              # references only
+#   crc_vectors.py --host firmware/z80neo/test/crc_host
+#   crc_vectors.py -p /dev/ttyACM1 -s /dev/ttyACM0 ../asm/crc_test.bin
+#
+# Without a board it checks the reference implementations against the
+# published check values. --host runs every vector through the host build of
+# z80_crc.c (firmware/z80neo/test), block, data port and a block that wraps
+# at the end of the bank. With a board, every vector is written to the bank
+# with ../asm/crc_test.bin, which runs CRC-16/CCITT-FALSE, CRC-32 and
+# Fletcher-16 over it both as a block (DMA sniffer) and through the data
+# port (tables). All six results must match the references. The port half
+# is a Z80 loop, raise --max-len only with a fast Z80 clock.
+
+import argparse
+import random
+import subprocess
+import sys
+
+VECTOR = 0x1000
+
+# the vector and its length word, up to the end of the bank
+MAX_VECTOR = 0x8000 - VECTOR - 2
+
+# published check values, of "123456789" unless noted
+CHECKS = [
+    ("crc16", b"123456789", 0x29B1),
+    ("crc32", b"123456789", 0xCBF43926),
+    ("fletcher16", b"123456789", 0x1EDE),
+    ("fletcher16", b"abcde", 0xC8F0),
+    ("fletcher16", b"abcdef", 0x2057),
+]
+
+
+def crc16(data, crc=0xFFFF):
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+        crc &= 0xFFFF
+    return crc
+
+
+def crc32(data, crc=0):
+    crc ^= 0xFFFFFFFF
+    for b in data:
+        crc ^= b
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0xEDB88320 if crc & 1 else crc >> 1
+    return crc ^ 0xFFFFFFFF
+
+
+def fletcher16(data):
+    s1 = s2 = 0
+    for b in data:
+        s1 = (s1 + b) % 255
+        s2 = (s2 + s1) % 255
+    return s2 << 8 | s1
+
+
+ALGOS = [crc16, crc32, fletcher16]
+
+
+def vectors(seed):
+    prng = random.Random(seed)
+
+    def rnd(n):
+        return bytes(prng.getrandbits(8) for _ in range(n))
+
+    return [
+        b"123456789",
+        b"\x00",
+        b"\xFF" * 32,
+        bytes(range(256)),
+        b"The quick brown fox jumps over the lazy dog",
+        rnd(1),
+        rnd(3),         # odd lengths, the sniffer works on bytes anyway
+        rnd(511),
+        rnd(4096),
+        rnd(MAX_VECTOR),  # the rest of the bank
+    ]
+
+
+def self_test():
+    ok = True
+    for name, data, want in CHECKS:
+        got = globals()[name](data)
+        good = got == want
+        ok &= good
+        print("%-10s %-12r %08X %s" % (name, data[:12], got, "ok" if good else "want %08X" % want))
+    return ok
+
+
+def host_test(harness, seed):
+    ok = True
+    for data in vectors(seed):
+        out = subprocess.run([harness], input=data, capture_output=True, check=True)
+        lines = out.stdout.decode().splitlines()
+
+        for algo, line in zip(ALGOS, lines + [""] * len(ALGOS)):
+            want = algo(data)
+            got = [int(x, 16) for x in line.split()]
+            good = got == [want] * 3
+            ok &= good
+            print("%-10s %6d bytes  %08X  %s%s" % (
+                algo.__name__, len(data), want, line or "no answer",
+                "" if good else "  MISMATCH"))
+
+    return ok
+
+
+def board_test(args):
+    import serial
+
+    from z80neo import Board
+
+    with open(args.binary, "rb") as f:
+        program = f.read()
+
+    board = Board(args.port)
+    board.ping()
+    ser = serial.Serial(args.serial, timeout=args.timeout)
+
+    ok = True
+    for data in vectors(args.seed):
+        if len(data) > args.max_len:
+            continue
+
+        ser.reset_input_buffer()
+        board.write(args.bank, 0, program)
+        board.write(args.bank, VECTOR, len(data).to_bytes(2, "little") + data)
+        board.run(args.bank)
+
+        for algo in ALGOS:
+            line = ser.readline().decode(errors="replace").split()
+            want = algo(data)
+            got = [int(x, 16) for x in line] if len(line) == 2 else []
+            good = got == [want, want]
+            ok &= good
+            print("%-10s %6d bytes  %08X  block %s  port %s%s" % (
+                algo.__name__, len(data), want,
+                "%08X" % got[0] if got else "--------",
+                "%08X" % got[1] if got else "--------",
+                "" if good else "  MISMATCH"))
+
+    return ok
+
+
+def main():
+    ap = argparse.ArgumentParser(description="z80neo CRC engine test vectors")
+    ap.add_argument("binary", nargs="?", help="crc_test.bin, runs the board test")
+    ap.add_argument("-p", "--port", help="CDC 1 (commands)")
+    ap.add_argument("-s", "--serial", help="CDC 0 (Z80 serial)")
+    ap.add_argument("-b", "--bank", type=int, default=1)
+    ap.add_argument("-t", "--timeout", type=float, default=600.0)
+    ap.add_argument("-m", "--max-len", type=int, default=64,
+                    help="longest vector, the port half runs at the Z80 clock")
+    ap.add_argument("--host", action="append", default=[],
+                    help="host build of z80_crc.c, firmware/z80neo/test/crc_host")
+    ap.add_argument("--seed", type=int, default=49, help="for the random vectors")
+    args = ap.parse_args()
+
+    ok = self_test()
+
+    for harness in args.host:
+        print(harness)
+        ok &= host_test(harness, args.seed)
+
+    if args.binary:
+        if not args.port or not args.serial:
+            ap.error("the board test needs --port and --serial")
+        ok &= board_test(args)
+
+    sys.exit(0 if ok else 1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+#
+# Decoder for the z80neo binary log (firmware/z80neo/include/log.h).
+#
+#   logdecode.py Z80NEO.LOG [Z80NEO.OLD ...]    # files from the SD card
+#   logdecode.py -p /dev/ttyACM1                # live, with log=raw in the INI
+#
+# Event formats come from log_events.h, which has to match the firmware that
+# wrote the records.
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+RECORD = struct.Struct("<IHBBII")  # time_us, id, level, core, a, b
+
+EVENTS_H = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                        "..", "..", "firmware", "z80neo", "include", "log_events.h")
+
+
+def load_events(path):
+    events = []
+    pattern = re.compile(r'^LOG_EVENT\(\s*(\w+)\s*,\s*(\w+)\s*,\s*"(.*)"\s*\)')
+    for line in open(path):
+        m = pattern.match(line)
+        if m:
+            # C long conversions to Python ones
+            events.append((m.group(1), re.sub(r"%(\d*)l", r"%\1", m.group(3))))
+    return events
+
+
+def decode(events, data):
+    for ofs in range(0, len(data) - RECORD.size + 1, RECORD.size):
+        t, ev, level, core, a, b = RECORD.unpack_from(data, ofs)
+        lvl = "DIWE"[level] if level < 4 else "?"
+
+        if ev < len(events):
+            fmt = events[ev][1]
+            try:
+                text = fmt % (a, b)
+            except TypeError:
+                # fewer conversions than arguments
+                text = fmt % (a,) if fmt.count("%") - 2 * fmt.count("%%") == 1 else fmt
+        else:
+            text = "? %d %08x %08x" % (ev, a, b)
+
+        print("%6d.%06d %s%d %s" % (t // 1000000, t % 1000000, lvl, core, text))
+
+
+def live(events, port):
+    sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+    from z80neo import Board, LOG
+
+    board = Board(port, timeout=None)
+    while True:
+        cmd, seq, body = board.read_frame()
+        if cmd == LOG:
+            decode(events, body[1:])
+            sys.stdout.flush()
+
+
+def main():
+    ap = argparse.ArgumentParser(description="z80neo log decoder")
+    ap.add_argument("files", nargs="*", help="raw log files")
+    ap.add_argument("-p", "--port", help="read PROTO_LOG frames from CDC 1")
+    ap.add_argument("-e", "--events", default=EVENTS_H, help="log_events.h")
+    args = ap.parse_args()
+
+    events = load_events(args.events)
+
+    for name in args.files:
+        decode(events, open(name, "rb").read())
+
+    if args.port:
+        live(events, args.port)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,572 @@
+#!/usr/bin/env python3
+#
+# ZX0 and LZ4 packer for z80neo, and tests of the decompression device
+# (firmware/z80neo/include/z80_unpack.h) and of compressed loading.
+#
+#   pack.py zx0 prog.bin PROG.ZX0          # files the loader takes from SD
+#   pack.py lz4 prog.bin PROG.LZ4          # LZ4 frame, like the lz4 tool
+#   pack.py test                           # round trips on the PC
+#   pack.py test --lib firmware/z80neo/test/libunpack.so
+#   pack.py board -p /dev/ttyACM1 -s /dev/ttyACM0 ../asm/unpack_test.bin
+#
+# The packers are simple greedy ones, z88dk's zx0 and the lz4 tool pack
+# tighter and their output loads the same. "test" unpacks every vector with
+# the Python unpackers and, given a host build of the firmware's unpack.c
+# (--lib, make -C firmware/z80neo/test builds it), with that too, including
+# short buffers and truncated streams. "board" packs every vector, has
+# the device unpack it from one bank into another, reads the result back
+# and prints how long the firmware took.
+
+import argparse
+import ctypes
+import random
+import shutil
+import struct
+import subprocess
+import sys
+import time
+
+ZX0, LZ4, LZ4_FRAME = 1, 2, 3
+
+LZ4_MAGIC = 0x184D2204
+
+BANK_SIZE = 0x8000
+
+
+#
+# Match finder, hash chains on 3 byte prefixes
+#
+
+class Matcher:
+    def __init__(self, data, window, chain=64):
+        self.data = data
+        self.window = window
+        self.chain = chain
+        self.heads = {}
+        self.prev = [-1] * len(data)
+        self.added = 0
+
+    def _add_upto(self, pos):
+        d = self.data
+        while self.added < pos and self.added + 3 <= len(d):
+            key = d[self.added:self.added + 3]
+            self.prev[self.added] = self.heads.get(key, -1)
+            self.heads[key] = self.added
+            self.added += 1
+
+    def longest(self, pos, limit):
+        d = self.data
+        self._add_upto(pos)
+        best_len, best_off = 0, 0
+        if pos + 3 > len(d):
+            return best_off, best_len
+        cand = self.heads.get(d[pos:pos + 3], -1)
+        tries = self.chain
+        while cand >= 0 and pos - cand <= self.window and tries:
+            n = 0
+            while n < limit and d[cand + n] == d[pos + n]:
+                n += 1
+            if n > best_len:
+                best_len, best_off = n, pos - cand
+            cand = self.prev[cand]
+            tries -= 1
+        return best_off, best_len
+
+
+def match_len(data, pos, offset, limit):
+    n = 0
+    while n < limit and data[pos + n - offset] == data[pos + n]:
+        n += 1
+    return n
+
+
+#
+# ZX0, v2 format
+#
+
+class BitWriter:
+    def __init__(self):
+        self.out = bytearray()
+        self.mask = 0
+        self.index = 0
+        self.backtrack = None
+
+    def byte(self, b):
+        self.out.append(b)
+
+    def bit(self, b):
+        if self.backtrack is not None:
+            self.out[self.backtrack] |= b
+            self.backtrack = None
+            return
+        if not self.mask:
+            self.out.append(0)
+            self.index = len(self.out) - 1
+            self.mask = 0x80
+        if b:
+            self.out[self.index] |= self.mask
+        self.mask >>= 1
+
+    def gamma(self, value, inverted=0):
+        for c in bin(value)[3:]:
+            self.bit(0)
+            self.bit(int(c) ^ inverted)
+        self.bit(1)
+
+
+def zx0_pack(data):
+    data = bytes(data)
+    n = len(data)
+    if not n:
+        raise ValueError("ZX0 can't pack nothing")
+
+    m = Matcher(data, 32640)
+    tokens = []
+    last = 1
+    lit_start = 0
+    pos = 1
+
+    while pos < n:
+        after_lits = pos > lit_start
+        off, ln = m.longest(pos, n - pos)
+        rep = match_len(data, pos, last, n - pos) if after_lits and last <= pos else 0
+
+        if rep and rep >= ln:
+            tokens.append(("L", data[lit_start:pos]))
+            tokens.append(("R", rep))
+            pos += rep
+            lit_start = pos
+        elif ln >= 3 or (ln == 2 and off <= 128):
+            if after_lits:
+                tokens.append(("L", data[lit_start:pos]))
+            tokens.append(("M", off, ln))
+            last = off
+            pos += ln
+            lit_start = pos
+        else:
+            pos += 1
+
+    if lit_start < n:
+        tokens.append(("L", data[lit_start:n]))
+
+    w = BitWriter()
+    for i, t in enumerate(tokens):
+        if t[0] == "L":
+            if i:
+                w.bit(0)
+            w.gamma(len(t[1]))
+            for b in t[1]:
+                w.byte(b)
+        elif t[0] == "R":
+            w.bit(0)
+            w.gamma(t[1])
+        else:
+            _, off, ln = t
+            w.bit(1)
+            w.gamma((off - 1) // 128 + 1, 1)
+            w.byte((127 - (off - 1) % 128) << 1)
+            w.backtrack = len(w.out) - 1
+            w.gamma(ln - 1)
+
+    w.bit(1)
+    w.gamma(256, 1)
+
+    return bytes(w.out)
+
+
+def zx0_unpack(src):
+    out = bytearray()
+    st = dict(pos=0, mask=0, bits=0, last=0, back=False)
+
+    def byte():
+        st["last"] = src[st["pos"]]
+        st["pos"] += 1
+        return st["last"]
+
+    def bit():
+        if st["back"]:
+            st["back"] = False
+            return st["last"] & 1
+        st["mask"] >>= 1
+        if not st["mask"]:
+            st["mask"] = 0x80
+            st["bits"] = byte()
+        return 1 if st["bits"] & st["mask"] else 0
+
+    def gamma(inverted=0):
+        v = 1
+        while not bit():
+            v = v << 1 | (bit() ^ inverted)
+        return v
+
+    def copy(offset, length):
+        for _ in range(length):
+            out.append(out[-offset])
+
+    offset = 1
+    state = "lits"
+    while True:
+        if state == "lits":
+            for _ in range(gamma()):
+                out.append(byte())
+            if bit():
+                state = "new"
+                continue
+            copy(offset, gamma())
+            state = "new" if bit() else "lits"
+        else:
+            msb = gamma(1)
+            if msb == 256:
+                return bytes(out)
+            offset = msb * 128 - (byte() >> 1)
+            st["back"] = True
+            copy(offset, gamma() + 1)
+            state = "new" if bit() else "lits"
+
+
+#
+# LZ4, raw blocks and frames
+#
+
+def lz4_length(out, n):
+    while n >= 255:
+        out.append(255)
+        n -= 255
+    out.append(n)
+
+
+def lz4_pack_block(data):
+    data = bytes(data)
+    n = len(data)
+    m = Matcher(data, 65535)
+    out = bytearray()
+    lit_start = 0
+    pos = 0
+
+    # the format wants the last 5 bytes as literals and no match starting
+    # in the last 12
+    while pos + 12 <= n:
+        off, ln = m.longest(pos, n - 5 - pos)
+        if ln < 4:
+            pos += 1
+            continue
+        lits = data[lit_start:pos]
+        ml = ln - 4
+        out.append(min(len(lits), 15) << 4 | min(ml, 15))
+        if len(lits) >= 15:
+            lz4_length(out, len(lits) - 15)
+        out += lits
+        out += struct.pack("<H", off)
+        if ml >= 15:
+            lz4_length(out, ml - 15)
+        pos += ln
+        lit_start = pos
+
+    lits = data[lit_start:]
+    out.append(min(len(lits), 15) << 4)
+    if len(lits) >= 15:
+        lz4_length(out, len(lits) - 15)
+    out += lits
+
+    return bytes(out)
+
+
+def lz4_unpack_block(src):
+    out = bytearray()
+    p = 0
+
+    def length(n):
+        nonlocal p
+        if n == 15:
+            while True:
+                b = src[p]
+                p += 1
+                n += b
+                if b != 255:
+                    break
+        return n
+
+    while p < len(src):
+        token = src[p]
+        p += 1
+        ln = length(token >> 4)
+        out += src[p:p + ln]
+        p += ln
+        if p >= len(src):
+            break
+        off = src[p] | src[p + 1] << 8
+        p += 2
+        ml = length(token & 15) + 4
+        for _ in range(ml):
+            out.append(out[-off])
+
+    return bytes(out)
+
+
+def xxh32(data, seed=0):
+    P1, P2, P3, P4, P5 = 2654435761, 2246822519, 3266489917, 668265263, 374761393
+    M = 0xFFFFFFFF
+
+    def rotl(x, r):
+        return ((x << r) | (x >> (32 - r))) & M
+
+    def rnd(acc, lane):
+        return (rotl((acc + lane * P2) & M, 13) * P1) & M
+
+    n = len(data)
+    p = 0
+    if n >= 16:
+        v = [(seed + P1 + P2) & M, (seed + P2) & M, seed, (seed - P1) & M]
+        while p + 16 <= n:
+            for i in range(4):
+                v[i] = rnd(v[i], struct.unpack_from("<I", data, p)[0])
+                p += 4
+        h = (rotl(v[0], 1) + rotl(v[1], 7) + rotl(v[2], 12) + rotl(v[3], 18)) & M
+    else:
+        h = (seed + P5) & M
+    h = (h + n) & M
+    while p + 4 <= n:
+        h = (rotl((h + struct.unpack_from("<I", data, p)[0] * P3) & M, 17) * P4) & M
+        p += 4
+    while p < n:
+        h = (rotl((h + data[p] * P5) & M, 11) * P1) & M
+        p += 1
+    h ^= h >> 15
+    h = (h * P2) & M
+    h ^= h >> 13
+    h = (h * P3) & M
+    h ^= h >> 16
+    return h
+
+
+def lz4_pack(data):
+    flg, bd = 0x60, 0x40  # version 1, independent blocks, 64 KB blocks
+    out = bytearray(struct.pack("<IBB", LZ4_MAGIC, flg, bd))
+    out.append((xxh32(bytes([flg, bd])) >> 8) & 0xFF)
+
+    for ofs in range(0, len(data), 0x10000):
+        raw = bytes(data[ofs:ofs + 0x10000])
+        packed = lz4_pack_block(raw)
+        if len(packed) < len(raw):
+            out += struct.pack("<I", len(packed)) + packed
+        else:
+            out += struct.pack("<I", len(raw) | 0x80000000) + raw
+
+    out += struct.pack("<I", 0)
+    return bytes(out)
+
+
+def lz4_unpack(src):
+    magic, flg, bd = struct.unpack_from("<IBB", src, 0)
+    if magic != LZ4_MAGIC:
+        raise ValueError("not an LZ4 frame")
+    p = 6 + (8 if flg & 0x08 else 0) + (4 if flg & 0x01 else 0) + 1
+    out = bytearray()
+    while True:
+        size = struct.unpack_from("<I", src, p)[0]
+        p += 4
+        if not size:
+            return bytes(out)
+        block = src[p:p + (size & 0x7FFFFFFF)]
+        out += block if size & 0x80000000 else lz4_unpack_block(block)
+        p += (size & 0x7FFFFFFF) + (4 if flg & 0x10 else 0)
+
+
+PACKERS = {
+    ZX0: ("zx0", zx0_pack, zx0_unpack),
+    LZ4: ("lz4", lz4_pack_block, lz4_unpack_block),
+    LZ4_FRAME: ("lz4 frame", lz4_pack, lz4_unpack),
+}
+
+
+#
+# Tests
+#
+
+def vectors(seed=50):
+    prng = random.Random(seed)
+
+    def rnd(n):
+        return bytes(prng.getrandbits(8) for _ in range(n))
+
+    text = b"Z80 programs ship compressed assets. " * 40
+    return [
+        b"A",
+        b"AB",
+        b"\x00" * 100,
+        b"abcabcabcabcabcabcabcabc",
+        bytes(range(256)) * 4,
+        text,
+        rnd(64),                     # incompressible
+        rnd(200) + b"\x55" * 3000,
+        bytes(i * 7 & 0xFF for i in range(20000)),
+        text * 10 + rnd(1000),       # near the end of a bank
+    ]
+
+
+class FirmwareUnpack:
+    """unpack() from firmware/z80neo/src/unpack.c, built as a shared library"""
+
+    ERROR = -1
+
+    def __init__(self, path):
+        self.lib = ctypes.CDLL(path)
+        self.lib.unpack.restype = ctypes.c_int
+        self.lib.unpack.argtypes = [ctypes.c_int, ctypes.c_char_p, ctypes.c_size_t,
+                                    ctypes.c_char_p, ctypes.c_size_t]
+
+    def __call__(self, fmt, packed, dst_len=BANK_SIZE):
+        dst = ctypes.create_string_buffer(dst_len + 16)
+        n = self.lib.unpack(fmt, bytes(packed), len(packed), dst, dst_len)
+        # nothing past dst_len, the guard bytes stay zero
+        if dst.raw[dst_len:] != bytes(16):
+            raise AssertionError("unpack wrote past the end of dst")
+        return n, dst.raw[:max(n, 0)]
+
+
+def firmware_checks(fw, fmt, data, packed):
+    n, out = fw(fmt, packed)
+    if n != len(data) or out != data:
+        return "MISMATCH"
+
+    # exactly the room it needs, and one byte less
+    if fw(fmt, packed, len(data))[0] != len(data):
+        return "tight dst"
+    if data and fw(fmt, packed, len(data) - 1)[0] != fw.ERROR:
+        return "short dst"
+
+    # cut short, it must not claim the whole output
+    for cut in (1, len(packed) // 2, len(packed) - 1):
+        if 0 < cut < len(packed) and fw(fmt, packed[:cut])[1] == data:
+            return "truncated at %d" % cut
+
+    return None
+
+
+# frames from the lz4 tool when it's installed: block checksums and content
+# size, and linked blocks
+LZ4_TOOL_OPTS = [[], ["-BX", "--content-size"], ["-BD", "-B4"]]
+
+
+def lz4_tool(opts):
+    def pack(data):
+        return subprocess.run(["lz4", "-c", "-9"] + opts, input=data,
+                              capture_output=True, check=True).stdout
+    return pack
+
+
+def host_test(lib=None):
+    fw = FirmwareUnpack(lib) if lib else None
+    packers = list(PACKERS.items())
+    if shutil.which("lz4"):
+        packers += [(LZ4_FRAME, ("lz4 tool", lz4_tool(opts), lz4_unpack))
+                    for opts in LZ4_TOOL_OPTS]
+
+    ok = True
+    for data in vectors():
+        for fmt, (name, pack, unpack) in packers:
+            packed = pack(data)
+            error = None if unpack(packed) == data else "MISMATCH"
+            if not error and fw:
+                error = firmware_checks(fw, fmt, data, packed)
+            ok &= not error
+            print("%-9s %6d -> %6d %s%s" % (name, len(data), len(packed),
+                                            "ok" if not error else error,
+                                            " (unpack.c too)" if fw and not error else ""))
+    return ok
+
+
+# where unpack_test.s takes its parameters, and the banks it works on
+PARAMS = 0x0F00
+SRC_BANK = 2
+DST_BANK = 3
+
+
+def board_test(args):
+    import serial
+
+    from z80neo import Board
+
+    with open(args.binary, "rb") as f:
+        program = f.read()
+
+    board = Board(args.port)
+    info = board.ping()
+    size = info["bank_size"]
+    ser = serial.Serial(args.serial, timeout=args.timeout)
+
+    ok = True
+    for data in vectors():
+        for fmt, (name, pack, unpack) in PACKERS.items():
+            packed = pack(data)
+            if len(packed) > size or len(data) > size:
+                continue
+
+            board.write(SRC_BANK, 0, packed)
+            board.write(DST_BANK, 0, bytes(size))
+            board.write(args.bank, 0, program)
+            board.write(args.bank, PARAMS, struct.pack("<BBBH", fmt, SRC_BANK, DST_BANK,
+                                                      len(packed)))
+            ser.reset_input_buffer()
+            board.run(args.bank)
+
+            # status, bytes, us
+            line = ser.readline().decode(errors="replace").split()
+            if len(line) != 3:
+                print("%-9s %6d  no answer" % (name, len(data)))
+                ok = False
+                continue
+            status, count, us = (int(x, 16) for x in line)
+
+            back = board.read(DST_BANK, 0, len(data))
+            good = status == 0 and count == len(data) and back == data
+            ok &= good
+
+            t = time.time()
+            unpack(packed)
+            host_us = (time.time() - t) * 1e6
+
+            print("%-9s %6d -> %6d  %8d us  %7.0f KB/s  (python %8.0f us)%s" % (
+                name, len(data), len(packed), us,
+                len(data) / 1024 / (us / 1e6) if us else 0, host_us,
+                "" if good else "  MISMATCH status %02X count %d" % (status, count)))
+
+    return ok
+
+
+def main():
+    ap = argparse.ArgumentParser(description="z80neo ZX0/LZ4 packer and tests")
+    sub = ap.add_subparsers(dest="cmd", required=True)
+
+    for name in ("zx0", "lz4"):
+        p = sub.add_parser(name, help="pack a file")
+        p.add_argument("input")
+        p.add_argument("output")
+
+    p = sub.add_parser("test", help="round trips on the PC")
+    p.add_argument("--lib", help="host build of unpack.c, libunpack.so")
+
+    p = sub.add_parser("board", help="round trips through the device")
+    p.add_argument("binary", help="unpack_test.bin")
+    p.add_argument("-p", "--port", required=True, help="CDC 1 (commands)")
+    p.add_argument("-s", "--serial", required=True, help="CDC 0 (Z80 serial)")
+    p.add_argument("-b", "--bank", type=int, default=1)
+    p.add_argument("-t", "--timeout", type=float, default=600.0)
+
+    args = ap.parse_args()
+
+    if args.cmd in ("zx0", "lz4"):
+        with open(args.input, "rb") as f:
+            data = f.read()
+        packed = zx0_pack(data) if args.cmd == "zx0" else lz4_pack(data)
+        with open(args.output, "wb") as f:
+            f.write(packed)
+        print("%d -> %d bytes" % (len(data), len(packed)))
+        return
+
+    ok = host_test(args.lib) if args.cmd == "test" else board_test(args)
+    sys.exit(0 if ok else 1)
+
+
+if __name__ == "__main__":
+    main()
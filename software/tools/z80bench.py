@@ -0,0 +1,79 @@
+#!/usr/bin/env python3
+#
+# Times Z80 benchmarks that mark their sections on the serial port.
+#
+#   z80bench.py -p /dev/ttyACM1 -s /dev/ttyACM0 ../asm/dma_bench.bin
+#
+# Uploads the program to a bank and runs it (CDC 1), then reads CDC 0. An
+# upper case letter starts a section and the same letter in lower case ends
+# it, any other byte (not a letter) is a result and printed as is. The Z80 takes seconds
+# for what the firmware does in microseconds, so the USB latency on the
+# markers is noise.
+
+import argparse
+import sys
+import time
+
+import serial
+
+from z80neo import Board
+
+
+def main():
+    ap = argparse.ArgumentParser(description="z80neo benchmark timer")
+    ap.add_argument("binary", help="program, assembled for address 0")
+    ap.add_argument("-p", "--port", required=True, help="CDC 1 (commands)")
+    ap.add_argument("-s", "--serial", required=True, help="CDC 0 (Z80 serial)")
+    ap.add_argument("-b", "--bank", type=int, default=1)
+    ap.add_argument("-t", "--timeout", type=float, default=600.0,
+                    help="seconds without output before giving up")
+    args = ap.parse_args()
+
+    with open(args.binary, "rb") as f:
+        data = f.read()
+
+    ser = serial.Serial(args.serial, timeout=args.timeout)
+    ser.reset_input_buffer()
+
+    board = Board(args.port)
+    board.ping()
+    board.write(args.bank, 0, data)
+    board.run(args.bank)
+
+    started = {}
+    times = {}
+    results = b""
+
+    while True:
+        c = ser.read(1)
+        if not c:
+            break
+        now = time.time()
+        ch = chr(c[0])
+
+        if ch.isupper():
+            started[ch] = now
+        elif ch.islower() and ch.upper() in started:
+            times[ch.upper()] = now - started.pop(ch.upper())
+        else:
+            results += c
+
+        # done once nothing is open and the results came in
+        if times and not started and results:
+            break
+
+    for name, secs in times.items():
+        print("%s %10.3f s" % (name, secs))
+    if results:
+        print("result %s" % results.decode(errors="replace"))
+
+    if len(times) >= 2:
+        base = list(times.values())[0]
+        for name, secs in list(times.items())[1:]:
+            print("%s vs %s  x%.1f" % (name, list(times)[0], base / secs if secs else 0))
+
+    sys.exit(0 if times else 1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,332 @@
+#!/usr/bin/env python3
+#
+# z80neo host tool, talks the binary protocol of firmware/z80neo/include/proto.h
+# on the second CDC interface of the board.
+#
+#   z80neo.py -p /dev/ttyACM1 ping
+#   z80neo.py -p /dev/ttyACM1 upload leds.bin --bank 1 --run
+#   z80neo.py -p /dev/ttyACM1 read 1 0x0000 64
+#   z80neo.py -p /dev/ttyACM1 bank 2 | reset | run 2
+#   z80neo.py loopback firmware/z80neo/test/proto_loopback
+#
+# loopback runs the host build of proto.c on a pty and tests this tool and
+# the firmware's framing against each other, no board needed.
+#
+# Needs pyserial.
+
+import argparse
+import random
+import struct
+import subprocess
+import sys
+import time
+
+import serial
+
+SOF = 0xA5
+
+PING, WRITE, READ, BANK, RESET, RUN = range(1, 7)
+LOG = 0x40  # unsolicited, log=raw
+REPLY = 0x80
+
+STATUS = ["OK", "ERR_CRC", "ERR_LEN", "ERR_CMD", "ERR_ARG", "ERR_BUSY"]
+
+
+def crc16(data, crc=0xFFFF):
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+        crc &= 0xFFFF
+    return crc
+
+
+def frame(cmd, seq, payload=b""):
+    body = struct.pack("<BBH", cmd, seq, len(payload)) + payload
+    return bytes([SOF]) + body + struct.pack("<H", crc16(body))
+
+
+class Board:
+    def __init__(self, port, timeout=2.0):
+        self.ser = serial.Serial(port, timeout=timeout)
+        self.seq = 0
+        self.max_data = 1024
+
+    def _read(self, n):
+        data = self.ser.read(n)
+        if len(data) != n:
+            raise IOError("timeout")
+        return data
+
+    def read_frame(self):
+        # skip whatever text is still on the way (reports, log lines)
+        while self._read(1)[0] != SOF:
+            pass
+
+        hdr = self._read(4)
+        rcmd, rseq, rlen = struct.unpack("<BBH", hdr)
+        body = self._read(rlen)
+        (crc,) = struct.unpack("<H", self._read(2))
+
+        if crc != crc16(hdr + body):
+            raise IOError("reply CRC")
+
+        return rcmd, rseq, body
+
+    def request(self, cmd, payload=b""):
+        self.seq = (self.seq + 1) & 0xFF
+        self.ser.write(frame(cmd, self.seq, payload))
+
+        rcmd, rseq, body = self.read_frame()
+        while rcmd == LOG:
+            rcmd, rseq, body = self.read_frame()
+
+        if rcmd != cmd | REPLY or rseq != self.seq:
+            raise IOError("reply out of sequence")
+        if body[0]:
+            raise IOError(STATUS[body[0]] if body[0] < len(STATUS) else body[0])
+
+        return body[1:]
+
+    def ping(self):
+        ver, banks, size, max_data, flags = struct.unpack("<BBHHB", self.request(PING))
+        self.max_data = max_data
+        return dict(version=ver, banks=banks, bank_size=size,
+                    max_data=max_data, can_reset=bool(flags & 1))
+
+    def write(self, bank, addr, data):
+        for ofs in range(0, len(data), self.max_data):
+            chunk = data[ofs:ofs + self.max_data]
+            self.request(WRITE, struct.pack("<BH", bank, addr + ofs) + chunk)
+
+    def read(self, bank, addr, count):
+        out = b""
+        while len(out) < count:
+            n = min(self.max_data, count - len(out))
+            out += self.request(READ, struct.pack("<BHH", bank, addr + len(out), n))
+        return out
+
+    def bank(self, bank):
+        self.request(BANK, bytes([bank]))
+
+    def reset(self):
+        self.request(RESET)
+
+    def run(self, bank):
+        self.request(RUN, bytes([bank]))
+
+
+def loopback(harness):
+    proc = subprocess.Popen([harness], stdout=subprocess.PIPE, text=True)
+    try:
+        port = proc.stdout.readline().strip()
+        board = Board(port, timeout=2.0)
+        ser = board.ser
+        rnd = random.Random(40)
+        failed = []
+
+        def check(name, ok):
+            print("%-32s %s" % (name, "ok" if ok else "FAILED"))
+            if not ok:
+                failed.append(name)
+
+        def error(name, fn, status):
+            try:
+                fn()
+            except IOError as e:
+                check(name, str(e) == status)
+            else:
+                check(name, False)
+
+        # text up to the next frame, and that frame
+        def text_then_reply():
+            text = b""
+            while True:
+                c = ser.read(1)
+                if not c:
+                    return text, None
+                if c[0] == SOF:
+                    break
+                text += c
+            hdr = ser.read(4)
+            if len(hdr) != 4:
+                return text, None
+            rcmd, rseq, rlen = struct.unpack("<BBH", hdr)
+            body = ser.read(rlen)
+            crc = ser.read(2)
+            if len(body) != rlen or len(crc) != 2:
+                return text, None
+            return text, (rcmd, rseq, body, struct.unpack("<H", crc)[0] == crc16(hdr + body))
+
+        def text_line():
+            return ser.readline()
+
+        def next_seq():
+            board.seq = (board.seq + 1) & 0xFF
+            return board.seq
+
+        info = board.ping()
+        check("ping", info == dict(version=1, banks=8, bank_size=0x8000,
+                                   max_data=1024, can_reset=False))
+
+        data = bytes(rnd.getrandbits(8) for _ in range(5000))
+        board.write(3, 0x1234, data)
+        check("write/read 5000 bytes", board.read(3, 0x1234, len(data)) == data)
+
+        end = bytes(rnd.getrandbits(8) for _ in range(16))
+        board.write(7, 0x8000 - len(end), end)
+        check("last bytes of the last bank", board.read(7, 0x8000 - len(end), 16) == end)
+
+        error("write past the bank", lambda: board.write(0, 0x7FFF, b"ab"), "ERR_ARG")
+        error("read from bank 8", lambda: board.read(8, 0, 1), "ERR_ARG")
+        error("unknown command", lambda: board.request(0x30), "ERR_CMD")
+        error("RUN without a bank", lambda: board.request(RUN), "ERR_LEN")
+
+        board.bank(2)
+        board.reset()
+        board.run(1)
+        check("bank, reset, run", True)
+
+        # corrupt CRC
+        seq = next_seq()
+        bad = bytearray(frame(PING, seq))
+        bad[-1] ^= 0xFF
+        ser.write(bad)
+        text, r = text_then_reply()
+        check("bad CRC", r is not None and r[:3] == (PING | REPLY, seq, bytes([1])))
+
+        # a text command with a frame right behind it in the same write
+        seq = next_seq()
+        ser.write(b"RESET\r\n" + frame(PING, seq))
+        text, r = text_then_reply()
+        check("text, then a frame", text == b"TEXT RESET\r\n" and r is not None and
+              r[0] == PING | REPLY and r[1] == seq and r[3])
+
+        # no line end, the frame ends it
+        seq = next_seq()
+        ser.write(b"NMI" + frame(PING, seq))
+        text, r = text_then_reply()
+        check("text cut short by a frame", text == b"TEXT NMI\r\n" and r is not None and
+              r[1] == seq)
+
+        # split over two writes, like two USB packets
+        ser.write(b"LOAD LE")
+        ser.flush()
+        time.sleep(0.05)
+        ser.write(b"DS.BIN 1\r\n")
+        check("text split over two writes", text_line() == b"TEXT LOAD LEDS.BIN 1\r\n")
+
+        ser.write(b"\r\n\r\nRUN 2\r\n")
+        check("empty lines skipped", text_line() == b"TEXT RUN 2\r\n")
+
+        ser.write(b"X" * 100 + b"\r\nBENCH\r\n")
+        check("over-long line dropped", text_line() == b"ERR LINE\r\n" and
+              text_line() == b"TEXT BENCH\r\n")
+
+        # frames one after the other in a single write
+        seqs = [next_seq() for _ in range(8)]
+        ser.write(b"".join(frame(READ, s, struct.pack("<BHH", 3, 0x1234, 64)) for s in seqs))
+        replies = [text_then_reply()[1] for _ in seqs]
+        check("8 frames in one write", all(
+            r is not None and r[1] == s and r[2] == b"\0" + data[:64] for r, s in zip(replies, seqs)))
+
+        check("still in step", board.read(3, 0x1234, 16) == data[:16])
+
+        return not failed
+    finally:
+        proc.terminate()
+        proc.wait()
+
+
+def hexdump(addr, data):
+    for ofs in range(0, len(data), 16):
+        row = data[ofs:ofs + 16]
+        print("%04X  %-48s %s" % (addr + ofs, " ".join("%02X" % b for b in row),
+              "".join(chr(b) if 32 <= b < 127 else "." for b in row)))
+
+
+def number(s):
+    return int(s, 0)
+
+
+def main():
+    ap = argparse.ArgumentParser(description="z80neo host tool")
+    ap.add_argument("-p", "--port", help="second CDC port of the board")
+    sub = ap.add_subparsers(dest="cmd", required=True)
+
+    sub.add_parser("ping")
+
+    p = sub.add_parser("upload", help="write a BIN image into a bank")
+    p.add_argument("file")
+    p.add_argument("--bank", type=number, default=0)
+    p.add_argument("--addr", type=number, default=0)
+    p.add_argument("--verify", action="store_true")
+    p.add_argument("--run", action="store_true", help="run the bank afterwards")
+
+    p = sub.add_parser("read", help="dump memory")
+    p.add_argument("bank", type=number)
+    p.add_argument("addr", type=number)
+    p.add_argument("count", type=number)
+    p.add_argument("-o", "--output", help="save to a file instead")
+
+    p = sub.add_parser("bank", help="switch the bank the Z80 runs from")
+    p.add_argument("bank", type=number)
+
+    sub.add_parser("reset")
+
+    p = sub.add_parser("run", help="switch bank and restart")
+    p.add_argument("bank", type=number)
+
+    p = sub.add_parser("loopback", help="test against the host build of proto.c")
+    p.add_argument("harness", help="firmware/z80neo/test/proto_loopback")
+
+    args = ap.parse_args()
+
+    if args.cmd == "loopback":
+        sys.exit(0 if loopback(args.harness) else 1)
+    if not args.port:
+        ap.error("the board needs -p")
+
+    board = Board(args.port)
+    info = board.ping()
+
+    if args.cmd == "ping":
+        print(" ".join("%s=%s" % kv for kv in info.items()))
+
+    elif args.cmd == "upload":
+        data = open(args.file, "rb").read()
+        if args.addr + len(data) > info["bank_size"]:
+            sys.exit("image does not fit the bank")
+
+        start = time.time()
+        board.write(args.bank, args.addr, data)
+        secs = time.time() - start
+        print("%d bytes in %.3f s, %.1f KB/s" % (len(data), secs, len(data) / 1024 / secs if secs else 0))
+
+        if args.verify and board.read(args.bank, args.addr, len(data)) != data:
+            sys.exit("verify failed")
+        if args.run:
+            board.run(args.bank)
+
+    elif args.cmd == "read":
+        data = board.read(args.bank, args.addr, args.count)
+        if args.output:
+            open(args.output, "wb").write(data)
+        else:
+            hexdump(args.addr, data)
+
+    elif args.cmd == "bank":
+        board.bank(args.bank)
+
+    elif args.cmd == "reset":
+        board.reset()
+
+    elif args.cmd == "run":
+        board.run(args.bank)
+
+    if args.cmd in ("reset", "run") and not info["can_reset"]:
+        print("no /RESET on this board, reset the Z80 by hand")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,127 @@
+; z80neo math coprocessor, wrappers for z80math.h
+;
+; Callee functions take their arguments from the stack, first argument on
+; top, and pop them. Results come back in HL or DEHL. The registers are in
+; memory, from MATH_BASE (z80_math.h).
+;
+; Plain assembler programs can INCLUDE this file too (math_bench.s).
+
+MATH_A:			equ 0x00B0
+MATH_B:			equ 0x00B4
+MATH_OP:		equ 0x00B8
+MATH_STATUS:	equ 0x00B8
+MATH_R:			equ 0x00B9
+
+MATH_MUL16:		equ 1
+MATH_MULS16:	equ 2
+MATH_MUL32:		equ 3
+MATH_MULS32:	equ 4
+MATH_DIV16:		equ 5
+MATH_DIVS16:	equ 6
+MATH_DIV32:		equ 7
+MATH_DIVS32:	equ 8
+MATH_SQRT:		equ 9
+MATH_FIXMUL:	equ 10
+MATH_FIXDIV:	equ 11
+
+PUBLIC _z80m_mul16, _z80m_muls16, _z80m_mul32, _z80m_muls32
+PUBLIC _z80m_div16, _z80m_mod16, _z80m_divs16, _z80m_mods16
+PUBLIC _z80m_div32, _z80m_mod32, _z80m_divs32, _z80m_mods32
+PUBLIC _z80m_sqrt32, _z80m_fixmul, _z80m_fixdiv, _z80m_error
+
+;-- 16 bit operands: C = opcode, B = 0 for the low result word, 1 for
+;-- the high one (remainder)
+
+_z80m_mul16:
+  ld	bc,		MATH_MUL16
+  jr	math_call16
+_z80m_muls16:
+  ld	bc,		MATH_MULS16
+  jr	math_call16
+_z80m_div16:
+  ld	bc,		MATH_DIV16
+  jr	math_call16
+_z80m_mod16:
+  ld	bc,		0x100 + MATH_DIV16
+  jr	math_call16
+_z80m_divs16:
+  ld	bc,		MATH_DIVS16
+  jr	math_call16
+_z80m_mods16:
+  ld	bc,		0x100 + MATH_DIVS16
+
+math_call16:
+  pop	de						; return address
+  pop	hl
+  ld	(MATH_A), hl
+  pop	hl
+  ld	(MATH_B), hl
+  push	de
+  jr	math_run
+
+;-- 32 bit operands, same as above
+
+_z80m_mul32:
+  ld	bc,		MATH_MUL32
+  jr	math_call32
+_z80m_muls32:
+  ld	bc,		MATH_MULS32
+  jr	math_call32
+_z80m_div32:
+  ld	bc,		MATH_DIV32
+  jr	math_call32
+_z80m_mod32:
+  ld	bc,		0x100 + MATH_DIV32
+  jr	math_call32
+_z80m_divs32:
+  ld	bc,		MATH_DIVS32
+  jr	math_call32
+_z80m_mods32:
+  ld	bc,		0x100 + MATH_DIVS32
+  jr	math_call32
+_z80m_fixmul:
+  ld	bc,		MATH_FIXMUL
+  jr	math_call32
+_z80m_fixdiv:
+  ld	bc,		MATH_FIXDIV
+
+math_call32:
+  pop	de						; return address
+  pop	hl
+  ld	(MATH_A), hl
+  pop	hl
+  ld	(MATH_A + 2), hl
+  pop	hl
+  ld	(MATH_B), hl
+  pop	hl
+  ld	(MATH_B + 2), hl
+  push	de
+
+math_run:
+  ld	A,		C
+  ld	(MATH_OP), A
+  ld	A,		B
+  or	A
+  jr	nz,		math_high
+  ld	HL,		(MATH_R)
+  ld	DE,		(MATH_R + 2)
+  ret
+math_high:
+  ld	HL,		(MATH_R + 4)
+  ld	DE,		(MATH_R + 6)
+  ret
+
+;-- Fastcall, the argument comes in DEHL
+
+_z80m_sqrt32:
+  ld	(MATH_A), hl
+  ld	(MATH_A + 2), de
+  ld	A,		MATH_SQRT
+  ld	(MATH_OP), A
+  ld	HL,		(MATH_R)
+  ret
+
+_z80m_error:
+  ld	A,		(MATH_STATUS)
+  ld	L,		A
+  ret
@@ -0,0 +1,43 @@
+/*
+ * z80neo math coprocessor (firmware/z80neo/include/z80_math.h) for C
+ * programs built with z88dk and zsdcc, the default sdcccall(0) convention:
+ *
+ *   zcc +z80 -compiler=sdcc -clib=sdcc_iy prog.c z80math.asm -o prog -create-app
+ *
+ * Needs devices=...,math in Z80NEO.INI. Every call is a few bus cycles
+ * instead of a software loop.
+ */
+
+#ifndef Z80MATH_H
+#define Z80MATH_H
+
+#include <stdint.h>
+
+extern uint32_t z80m_mul16(uint16_t a, uint16_t b) __z88dk_callee;
+extern int32_t z80m_muls16(int16_t a, int16_t b) __z88dk_callee;
+extern uint32_t z80m_mul32(uint32_t a, uint32_t b) __z88dk_callee;
+extern int32_t z80m_muls32(int32_t a, int32_t b) __z88dk_callee;
+
+extern uint16_t z80m_div16(uint16_t a, uint16_t b) __z88dk_callee;
+extern uint16_t z80m_mod16(uint16_t a, uint16_t b) __z88dk_callee;
+extern int16_t z80m_divs16(int16_t a, int16_t b) __z88dk_callee;
+extern int16_t z80m_mods16(int16_t a, int16_t b) __z88dk_callee;
+extern uint32_t z80m_div32(uint32_t a, uint32_t b) __z88dk_callee;
+extern uint32_t z80m_mod32(uint32_t a, uint32_t b) __z88dk_callee;
+extern int32_t z80m_divs32(int32_t a, int32_t b) __z88dk_callee;
+extern int32_t z80m_mods32(int32_t a, int32_t b) __z88dk_callee;
+
+extern uint16_t z80m_sqrt32(uint32_t a) __z88dk_fastcall;
+
+/* 16.16 fixed point */
+typedef int32_t fix16;
+
+#define FIX16(x) ((fix16)((x) * 65536.0))
+
+extern fix16 z80m_fixmul(fix16 a, fix16 b) __z88dk_callee;
+extern fix16 z80m_fixdiv(fix16 a, fix16 b) __z88dk_callee;
+
+/* status of the last call, nonzero after a division by zero or overflow */
+extern uint8_t z80m_error(void);
+
+#endif /* Z80MATH_H */